@@ -0,0 +1,26 @@
+TEMPLATE = app
+QT += quick quick3d gui concurrent
+
+CONFIG += qmltypes
+QML_IMPORT_NAME = VolumeTile
+QML_IMPORT_MAJOR_VERSION = 1
+
+# The density field is built from the same noise as the terrain example
+INCLUDEPATH += ../../src ../terrain
+
+SOURCES += \
+    main.cpp \
+    densityfield.cpp \
+    volumetile.cpp \
+    ../terrain/perlinnoise.cpp
+
+HEADERS += \
+    densityfield.h \
+    volumetile.h \
+    ../terrain/perlinnoise.h
+
+RESOURCES += \
+    resources.qrc
+
+target.path = $$[QT_INSTALL_EXAMPLES]/caves
+INSTALLS += target
@@ -0,0 +1,69 @@
+#include "densityfield.h"
+
+static const float s_groundScale = 0.003f;
+static const float s_groundHeight = 300;
+static const float s_overhangScale = 0.012f;
+static const float s_overhangStrength = 80;
+static const float s_caveScale = 0.02f;
+static const float s_caveWidth = 0.05f;
+static const float s_caveStrength = 400;
+
+Q_GLOBAL_STATIC(DensityField, s_densityField)
+
+DensityField *DensityField::instance()
+{
+    return s_densityField();
+}
+
+float DensityField::groundHeight(float x, float z)
+{
+    return (m_perlin.noise(x * s_groundScale, z * s_groundScale, 0.3) - 0.5) * s_groundHeight;
+}
+
+/**
+ * Sample the field on a block of \a countX * \a countY * \a countZ points of the grid
+ * with the given \a spacing that goes through the origin, starting at grid point
+ * (\a fromX, \a fromY, \a fromZ). The densities are written to \a densities with x
+ * changing fastest, then y, then z. Since the positions are calculated from the grid
+ * coordinates, a grid point gets exactly the same density in all the blocks it's part of.
+ *
+ * The height of the ground only depends on x and z, so it's sampled once per column
+ * rather than once per point. The noise is sampled one row at a time into separate
+ * arrays, so that combining them into densities becomes a tight loop over plain
+ * arrays that the compiler can vectorize.
+ */
+void DensityField::sample(const QVector3D &spacing, int fromX, int fromY, int fromZ,
+                          int countX, int countY, int countZ, float *densities)
+{
+    std::vector<float> ground(countX);
+    std::vector<float> overhang(countX);
+    std::vector<float> caveA(countX);
+    std::vector<float> caveB(countX);
+
+    for (int z = 0; z < countZ; ++z) {
+        const float posZ = (fromZ + z) * spacing.z();
+        for (int x = 0; x < countX; ++x)
+            ground[x] = groundHeight((fromX + x) * spacing.x(), posZ);
+
+        for (int y = 0; y < countY; ++y) {
+            const float posY = (fromY + y) * spacing.y();
+            for (int x = 0; x < countX; ++x) {
+                const float posX = (fromX + x) * spacing.x();
+                overhang[x] = m_perlin.noise(posX * s_overhangScale, posY * s_overhangScale, posZ * s_overhangScale);
+                // Caves are carved out where two independent noise fields are both close
+                // to their middle value, which gives long winding tunnels rather than blobs.
+                caveA[x] = m_perlin.noise(posX * s_caveScale, posY * s_caveScale, posZ * s_caveScale);
+                caveB[x] = m_perlin.noise(posX * s_caveScale + 100, posY * s_caveScale, posZ * s_caveScale);
+            }
+
+            float *row = densities + (z * countY + y) * countX;
+            for (int x = 0; x < countX; ++x) {
+                const float surface = ground[x] - posY + (overhang[x] - 0.5f) * s_overhangStrength;
+                const float a = caveA[x] - 0.5f;
+                const float b = caveB[x] - 0.5f;
+                const float cave = (std::sqrt(a * a + b * b) - s_caveWidth) * s_caveStrength;
+                row[x] = std::min(surface, cave);
+            }
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef DENSITYFIELD_H
+#define DENSITYFIELD_H
+
+#include <QtGui/QtGui>
+
+#include "perlinnoise.h"
+
+/**
+ * DensityField describes a volume of rock as a function of position, where the
+ * density is positive inside the rock, and negative outside (in the air). Unlike a
+ * height map it can describe overhangs and caves. The field only reads from the noise
+ * tables once it has been created, so it can be sampled from several threads at once.
+ */
+class DensityField
+{
+public:
+    static DensityField *instance();
+
+    void sample(const QVector3D &spacing, int fromX, int fromY, int fromZ,
+                int countX, int countY, int countZ, float *densities);
+
+private:
+    float groundHeight(float x, float z);
+
+private:
+    PerlinNoise m_perlin;
+};
+
+#endif // DENSITYFIELD_H
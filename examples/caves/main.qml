@@ -0,0 +1,83 @@
+import QtQuick
+import QtQuick3D
+import QtQuick3D.Helpers
+
+import QtQuick3D.TileView
+import VolumeTile
+
+Window {
+    id: window
+    width: 1024
+    height: 640
+    visible: true
+    color: "#848895"
+
+    View3D {
+        id: mainView
+        anchors.fill: parent
+        camera: personCamera
+        importScene: scene
+        environment: SceneEnvironment {
+            clearColor: Qt.rgba(0.05, 0.05, 0.08, 1.0)
+            backgroundMode: SceneEnvironment.Color
+        }
+    }
+
+    Node {
+        id: scene
+
+        TileView {
+            id: tileView
+            center: personCamera.position
+            tileSize: Qt.vector3d(100, 100, 100)
+            tileCount: Qt.vector3d(6, 4, 6)
+
+            delegate: Model {
+                id: delegate
+
+                materials: [
+                    DefaultMaterial {
+                        diffuseColor: "#8a7f72"
+                    }
+                ]
+
+                // The mesh is generated on a worker thread, so streaming in
+                // a new layer of tiles doesn't stall the rendering.
+                geometry: VolumeTile {
+                    resolution: Qt.vector3d(16, 16, 16)
+                    tileSize: delegate.parent.tileSize
+                    position: delegate.position
+                }
+            }
+
+            Connections {
+                target: personCamera
+                function onRotationChanged() { tileView.direction = personCamera.forward }
+            }
+            Component.onCompleted: direction = personCamera.forward
+        }
+
+        PerspectiveCamera {
+            id: personCamera
+            position: Qt.vector3d(0, 0, 0)
+            clipNear: 1
+
+            PointLight {
+                color: Qt.rgba(1.0, 0.9, 0.8, 1.0)
+                brightness: 2
+                quadraticFade: 0.0005
+            }
+        }
+
+        DirectionalLight {
+            eulerRotation: Qt.vector3d(-45, 0, 0)
+            color: Qt.rgba(0.6, 0.6, 0.7, 1.0)
+            ambientColor: Qt.rgba(0.2, 0.2, 0.2, 1.0)
+        }
+    }
+
+    WasdController {
+        controlledObject: personCamera
+        speed: 0.1
+    }
+}
@@ -0,0 +1,302 @@
+#include "volumetile.h"
+#include "densityfield.h"
+#include "tiletrace.h"
+
+// The corners of a cell, numbered with bit 0, 1 and 2 telling if
+// the corner is on the upper side of the cell along x, y and z.
+static QVector3D cornerOffset(int corner)
+{
+    return QVector3D(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+}
+
+static const int s_cellEdges[12][2] = {
+    { 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 }, // along x
+    { 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 }, // along y
+    { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 }, // along z
+};
+
+VolumeTile::VolumeTile()
+{
+    connect(&m_watcher, &QFutureWatcher<Mesh>::finished, this, &VolumeTile::meshGenerated);
+}
+
+VolumeTile::~VolumeTile()
+{
+    // The mesh that is being generated is of no use to anyone anymore, but
+    // we can't leave it running, since the density field might go away first.
+    m_watcher.waitForFinished();
+}
+
+void VolumeTile::componentComplete()
+{
+    QQuick3DGeometry::componentComplete();
+
+    setStride((3 + 3) * sizeof(float)); // Vertices + normals
+    setPrimitiveType(QQuick3DGeometry::PrimitiveType::Triangles);
+    addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
+    addAttribute(QQuick3DGeometry::Attribute::NormalSemantic,
+                 3 * sizeof(float),
+                 QQuick3DGeometry::Attribute::F32Type);
+    addAttribute(QQuick3DGeometry::Attribute::IndexSemantic, 0, QQuick3DGeometry::Attribute::U32Type);
+
+    updateData();
+}
+
+QVector3D VolumeTile::tileSize() const
+{
+    return m_tileSize;
+}
+
+void VolumeTile::setTileSize(QVector3D tileSize)
+{
+    if (m_tileSize == tileSize)
+        return;
+
+    m_tileSize = tileSize;
+    updateData();
+    emit tileSizeChanged();
+}
+
+QVector3D VolumeTile::resolution() const
+{
+    return m_resolution;
+}
+
+void VolumeTile::setResolution(QVector3D resolution)
+{
+    if (m_resolution == resolution)
+        return;
+
+    m_resolution = resolution;
+    updateData();
+    emit resolutionChanged();
+}
+
+QVector3D VolumeTile::position() const
+{
+    return m_position;
+}
+
+void VolumeTile::setPosition(QVector3D position)
+{
+    if (m_position == position)
+        return;
+
+    m_position = position;
+
+    // The mesh we have belongs somewhere else now, so don't show it while the new one is generated
+    if (isComponentComplete())
+        applyMesh(Mesh());
+    updateData();
+    emit positionChanged();
+}
+
+bool VolumeTile::asynchronous() const
+{
+    return m_asynchronous;
+}
+
+/**
+ * When asynchronous is true (the default), the mesh is generated on a worker thread,
+ * and the tile keeps showing the mesh it had until the new one is ready. When the
+ * position changes the tile is empty until then instead, since the mesh it had
+ * belongs to another part of the world.
+ */
+void VolumeTile::setAsynchronous(bool asynchronous)
+{
+    if (m_asynchronous == asynchronous)
+        return;
+
+    m_asynchronous = asynchronous;
+    emit asynchronousChanged();
+}
+
+void VolumeTile::updateData()
+{
+    if (!isComponentComplete())
+        return;
+
+    if (m_watcher.isRunning()) {
+        // Generate again once the mesh that is being generated is done, since it's already outdated
+        m_updatePending = true;
+        return;
+    }
+
+    Request request;
+    request.position = m_position;
+    request.tileSize = m_tileSize;
+    request.resolutionX = qMax(1, int(m_resolution.x()));
+    request.resolutionY = qMax(1, int(m_resolution.y()));
+    request.resolutionZ = qMax(1, int(m_resolution.z()));
+
+    if (m_asynchronous)
+        m_watcher.setFuture(QtConcurrent::run(&VolumeTile::generateMesh, request));
+    else
+        applyMesh(generateMesh(request));
+}
+
+void VolumeTile::meshGenerated()
+{
+    if (m_updatePending) {
+        m_updatePending = false;
+        updateData();
+        return;
+    }
+
+    // Never show a mesh at a position that it wasn't generated for
+    const Mesh mesh = m_watcher.result();
+    if (mesh.position != m_position) {
+        updateData();
+        return;
+    }
+
+    applyMesh(mesh);
+}
+
+void VolumeTile::applyMesh(const Mesh &mesh)
+{
+    setVertexData(mesh.vertexData);
+    setIndexData(mesh.indexData);
+    setBounds(mesh.boundsMin, mesh.boundsMax);
+    update();
+}
+
+/**
+ * Generate the mesh for a tile from the density field using surface nets. Every cell
+ * of the grid that the surface passes through (where some corners are inside the rock,
+ * and some are outside) gets one vertex, placed at the average of where the surface
+ * crosses the edges of the cell. Then every grid edge that the surface crosses gets a
+ * quad that connects the vertices of the four cells around it.
+ *
+ * The quads around the edges on the lower side of the tile need the cells on the other
+ * side of it, so we also sample one layer of cells outside the tile along the negative
+ * axes. Those cells come out exactly the same in the neighbouring tile, which makes the
+ * tiles line up without seams. The edges on the upper side of the tile belong to the
+ * neighbours, so that every edge in the world gets its quad from exactly one tile.
+ *
+ * This function only depends on \a request and the density field, which makes it safe
+ * to call from any thread.
+ */
+VolumeTile::Mesh VolumeTile::generateMesh(const Request &request)
+{
+    TILE_TRACE_SCOPE("VolumeTile::generateMesh", "position", request.position);
+
+    const int resolution[3] = { request.resolutionX, request.resolutionY, request.resolutionZ };
+    const QVector3D dist = request.tileSize / QVector3D(resolution[0], resolution[1], resolution[2]);
+
+    // Sample the corners from -1 to resolution along each axis in one go. The tile
+    // is expected to be aligned to the grid, which the density field is sampled on.
+    const int cornerCount[3] = { resolution[0] + 2, resolution[1] + 2, resolution[2] + 2 };
+    std::vector<float> densities(cornerCount[0] * cornerCount[1] * cornerCount[2]);
+    DensityField::instance()->sample(dist,
+                                     qRound(request.position.x() / dist.x()) - 1,
+                                     qRound(request.position.y() / dist.y()) - 1,
+                                     qRound(request.position.z() / dist.z()) - 1,
+                                     cornerCount[0], cornerCount[1], cornerCount[2], densities.data());
+    const auto cornerIndex = [&](int x, int y, int z) {
+        return (z * cornerCount[1] + y) * cornerCount[0] + x;
+    };
+
+    // The cells go from -1 to resolution - 1, so cell i spans corner i to i + 1
+    const int cellCount[3] = { resolution[0] + 1, resolution[1] + 1, resolution[2] + 1 };
+    std::vector<quint32> cellVertices(cellCount[0] * cellCount[1] * cellCount[2], std::numeric_limits<quint32>::max());
+    const auto cellIndex = [&](int x, int y, int z) {
+        return (z * cellCount[1] + y) * cellCount[0] + x;
+    };
+
+    Mesh mesh;
+    mesh.position = request.position;
+    QVector<float> vertices;
+    quint32 vertexCount = 0;
+    QVector3D boundsMin(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
+    QVector3D boundsMax(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest());
+
+    for (int z = 0; z < cellCount[2]; ++z) {
+        for (int y = 0; y < cellCount[1]; ++y) {
+            for (int x = 0; x < cellCount[0]; ++x) {
+                float d[8];
+                int solid = 0;
+                for (int corner = 0; corner < 8; ++corner) {
+                    d[corner] = densities[cornerIndex(x + (corner & 1), y + ((corner >> 1) & 1), z + ((corner >> 2) & 1))];
+                    if (d[corner] > 0)
+                        solid |= 1 << corner;
+                }
+                if (solid == 0 || solid == 0xff)
+                    continue;
+
+                QVector3D sum;
+                int crossings = 0;
+                for (const auto &edge : s_cellEdges) {
+                    const float a = d[edge[0]];
+                    const float b = d[edge[1]];
+                    if ((a > 0) == (b > 0))
+                        continue;
+                    const QVector3D from = cornerOffset(edge[0]);
+                    const QVector3D to = cornerOffset(edge[1]);
+                    sum += from + (to - from) * (a / (a - b));
+                    ++crossings;
+                }
+
+                const QVector3D vertex = (QVector3D(x - 1, y - 1, z - 1) + sum / crossings) * dist;
+
+                // The density grows into the rock, so the surface faces the opposite way of the gradient
+                const QVector3D gradient((d[1] - d[0]) + (d[3] - d[2]) + (d[5] - d[4]) + (d[7] - d[6]),
+                                         (d[2] - d[0]) + (d[3] - d[1]) + (d[6] - d[4]) + (d[7] - d[5]),
+                                         (d[4] - d[0]) + (d[5] - d[1]) + (d[6] - d[2]) + (d[7] - d[3]));
+                const QVector3D normal = -(gradient / dist).normalized();
+
+                vertices << vertex.x() << vertex.y() << vertex.z();
+                vertices << normal.x() << normal.y() << normal.z();
+                cellVertices[cellIndex(x, y, z)] = vertexCount++;
+
+                boundsMin = QVector3D(qMin(boundsMin.x(), vertex.x()), qMin(boundsMin.y(), vertex.y()), qMin(boundsMin.z(), vertex.z()));
+                boundsMax = QVector3D(qMax(boundsMax.x(), vertex.x()), qMax(boundsMax.y(), vertex.y()), qMax(boundsMax.z(), vertex.z()));
+            }
+        }
+    }
+
+    QVector<quint32> indices;
+    for (int axis = 0; axis < 3; ++axis) {
+        // The two other axes, in an order that keeps the winding the same for all three
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+
+        // Only visit the edges that start inside the tile (corner 0 to resolution - 1)
+        int c[3];
+        for (c[2] = 1; c[2] <= resolution[2]; ++c[2]) {
+            for (c[1] = 1; c[1] <= resolution[1]; ++c[1]) {
+                for (c[0] = 1; c[0] <= resolution[0]; ++c[0]) {
+                    int end[3] = { c[0], c[1], c[2] };
+                    ++end[axis];
+                    const bool startSolid = densities[cornerIndex(c[0], c[1], c[2])] > 0;
+                    const bool endSolid = densities[cornerIndex(end[0], end[1], end[2])] > 0;
+                    if (startSolid == endSolid)
+                        continue;
+
+                    int cell[3] = { c[0], c[1], c[2] };
+                    const quint32 v0 = cellVertices[cellIndex(cell[0], cell[1], cell[2])];
+                    --cell[u];
+                    const quint32 v1 = cellVertices[cellIndex(cell[0], cell[1], cell[2])];
+                    --cell[v];
+                    const quint32 v2 = cellVertices[cellIndex(cell[0], cell[1], cell[2])];
+                    ++cell[u];
+                    const quint32 v3 = cellVertices[cellIndex(cell[0], cell[1], cell[2])];
+
+                    // Front face = counter-clockwise, seen from the air
+                    if (startSolid)
+                        indices << v0 << v1 << v2 << v0 << v2 << v3;
+                    else
+                        indices << v0 << v2 << v1 << v0 << v3 << v2;
+                }
+            }
+        }
+    }
+
+    mesh.vertexData = QByteArray(reinterpret_cast<const char *>(vertices.constData()), vertices.count() * sizeof(float));
+    mesh.indexData = QByteArray(reinterpret_cast<const char *>(indices.constData()), indices.count() * sizeof(quint32));
+    if (vertexCount > 0) {
+        mesh.boundsMin = boundsMin;
+        mesh.boundsMax = boundsMax;
+    }
+    return mesh;
+}
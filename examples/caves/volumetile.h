@@ -0,0 +1,78 @@
+#ifndef VOLUMETILE_H
+#define VOLUMETILE_H
+
+#include <QtGui/QtGui>
+#include <QtConcurrent/QtConcurrent>
+#include <QQuick3DGeometry>
+
+class VolumeTile : public QQuick3DGeometry
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QVector3D tileSize READ tileSize WRITE setTileSize NOTIFY tileSizeChanged)
+    Q_PROPERTY(QVector3D resolution READ resolution WRITE setResolution NOTIFY resolutionChanged)
+    Q_PROPERTY(QVector3D position READ position WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(bool asynchronous READ asynchronous WRITE setAsynchronous NOTIFY asynchronousChanged)
+
+public:
+    struct Request
+    {
+        QVector3D position;
+        QVector3D tileSize;
+        int resolutionX;
+        int resolutionY;
+        int resolutionZ;
+    };
+
+    struct Mesh
+    {
+        QVector3D position; // The position of the tile that the mesh was generated for
+        QByteArray vertexData;
+        QByteArray indexData;
+        QVector3D boundsMin;
+        QVector3D boundsMax;
+    };
+
+    VolumeTile();
+    ~VolumeTile() override;
+
+    QVector3D tileSize() const;
+    void setTileSize(QVector3D tileSize);
+
+    QVector3D resolution() const;
+    void setResolution(QVector3D resolution);
+
+    QVector3D position() const;
+    void setPosition(QVector3D position);
+
+    bool asynchronous() const;
+    void setAsynchronous(bool asynchronous);
+
+    static Mesh generateMesh(const Request &request);
+
+signals:
+    void tileSizeChanged();
+    void resolutionChanged();
+    void positionChanged();
+    void asynchronousChanged();
+
+protected:
+    void componentComplete() override;
+
+private:
+    void updateData();
+    void applyMesh(const Mesh &mesh);
+    void meshGenerated();
+
+private:
+    QVector3D m_position;
+    QVector3D m_tileSize = QVector3D(100, 100, 100);
+    QVector3D m_resolution = QVector3D(16, 16, 16);
+    bool m_asynchronous = true;
+
+    QFutureWatcher<Mesh> m_watcher;
+    bool m_updatePending = false;
+};
+
+#endif // VOLUMETILE_H
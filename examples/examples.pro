@@ -1,5 +1,6 @@
 TEMPLATE = subdirs
 SUBDIRS += \
+    caves \
     concept \
     stars \
     terrain \
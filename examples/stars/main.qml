@@ -5,6 +5,7 @@ import QtQuick3D
 import QtQuick3D.Helpers
 
 import QtQuick3D.TileView
+import TileSeededInstancing
 
 Window {
     id: window
@@ -46,17 +47,13 @@ Window {
             delegate: Node {
                 id: delegate
 
-                TileView.onTileChanged: {
-                    anim.duration = Math.random(10000) + Math.abs(10000 * (TileView.tile.x + TileView.tile.z))
-                    anim.restart()
-                }
-
                 Star {
                     id: star
-                    instancing: randomInstancing
+                    instancing: tileInstancing
                     PropertyAnimation {
-                        id: anim
                         target: star
+                        running: true
+                        duration: 20000
                         loops: Animation.Infinite
                         property: "eulerRotation"
                         from: Qt.vector3d(0, 0, 0)
@@ -64,15 +61,12 @@ Window {
                     }
                 }
 
-                RandomInstancing {
-                    id: randomInstancing
+                TileSeededInstancing {
+                    id: tileInstancing
+                    tile: delegate.TileView.tile
+                    seed: 42
                     instanceCount: delegate.parent.tileSize.x / 3
-                    position: InstanceRange {
-                        from: Qt.vector3d(delegate.parent.tileSize.x / 2,
-                                          delegate.parent.tileSize.y / 2,
-                                          delegate.parent.tileSize.z / 2)
-                        to: from.times(-1)
-                    }
+                    size: delegate.parent.tileSize
                 }
             }
 
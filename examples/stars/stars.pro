@@ -1,8 +1,16 @@
 TEMPLATE = app
 QT += quick quick3d
 
+CONFIG += qmltypes
+QML_IMPORT_NAME = TileSeededInstancing
+QML_IMPORT_MAJOR_VERSION = 1
+
 SOURCES += \
-    main.cpp
+    main.cpp \
+    tileseededinstancing.cpp
+
+HEADERS += \
+    tileseededinstancing.h
 
 RESOURCES += \
     resources.qrc \
@@ -0,0 +1,168 @@
+#include "tileseededinstancing.h"
+
+#include <cstring>
+
+// Tables for recently visited tiles are kept around, so that moving back
+// and forth across a tile boundary doesn't regenerate the same tables.
+static const int s_tableCacheSize = 16 * 1024 * 1024; // bytes
+
+static QCache<quint64, QByteArray> &tableCache()
+{
+    static QCache<quint64, QByteArray> cache(s_tableCacheSize);
+    return cache;
+}
+
+static inline quint64 mix(quint64 h)
+{
+    // splitmix64 finalizer
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+static inline quint64 combine(quint64 h, quint64 value)
+{
+    return mix(h ^ (value + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2)));
+}
+
+static inline quint32 floatBits(float value)
+{
+    quint32 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+TileSeededInstancing::TileSeededInstancing(QQuick3DObject *parent)
+    : QQuick3DInstancing(parent)
+{
+}
+
+QVector3D TileSeededInstancing::tile() const
+{
+    return m_tile;
+}
+
+void TileSeededInstancing::setTile(const QVector3D &tile)
+{
+    if (m_tile == tile)
+        return;
+
+    m_tile = tile;
+    markDirty();
+    emit tileChanged();
+}
+
+int TileSeededInstancing::seed() const
+{
+    return m_seed;
+}
+
+void TileSeededInstancing::setSeed(int seed)
+{
+    if (m_seed == seed)
+        return;
+
+    m_seed = seed;
+    markDirty();
+    emit seedChanged();
+}
+
+int TileSeededInstancing::instanceCount() const
+{
+    return m_instanceCount;
+}
+
+void TileSeededInstancing::setInstanceCount(int instanceCount)
+{
+    if (m_instanceCount == instanceCount)
+        return;
+
+    m_instanceCount = instanceCount;
+    markDirty();
+    emit instanceCountChanged();
+}
+
+QVector3D TileSeededInstancing::size() const
+{
+    return m_size;
+}
+
+void TileSeededInstancing::setSize(const QVector3D &size)
+{
+    if (m_size == size)
+        return;
+
+    m_size = size;
+    markDirty();
+    emit sizeChanged();
+}
+
+quint64 TileSeededInstancing::tableKey() const
+{
+    quint64 key = mix(quint64(quint32(m_seed)));
+    key = combine(key, quint64(qint64(m_tile.x())));
+    key = combine(key, quint64(qint64(m_tile.y())));
+    key = combine(key, quint64(qint64(m_tile.z())));
+    key = combine(key, quint64(m_instanceCount));
+    key = combine(key, floatBits(m_size.x()));
+    key = combine(key, floatBits(m_size.y()));
+    key = combine(key, floatBits(m_size.z()));
+    return key;
+}
+
+QByteArray TileSeededInstancing::generateTable(quint64 key) const
+{
+    const int count = m_instanceCount;
+
+    // Generate the positions in one pass over plain arrays first. Each instance
+    // only depends on the key and its own index (counter based hashing, rather
+    // than a sequential random generator), which lets the compiler vectorize it.
+    QVector<float> xs(count);
+    QVector<float> ys(count);
+    QVector<float> zs(count);
+    const float unit = 1.0f / float(0x1fffff);
+    for (int i = 0; i < count; ++i) {
+        const quint64 h = mix(key + quint64(i) * 0x9e3779b97f4a7c15ull);
+        xs[i] = float(h & 0x1fffff) * unit - 0.5f;
+        ys[i] = float((h >> 21) & 0x1fffff) * unit - 0.5f;
+        zs[i] = float((h >> 42) & 0x1fffff) * unit - 0.5f;
+    }
+
+    QByteArray table;
+    table.resize(count * int(sizeof(InstanceTableEntry)));
+    auto entry = reinterpret_cast<InstanceTableEntry *>(table.data());
+    for (int i = 0; i < count; ++i, ++entry) {
+        entry->row0 = QVector4D(1, 0, 0, xs[i] * m_size.x());
+        entry->row1 = QVector4D(0, 1, 0, ys[i] * m_size.y());
+        entry->row2 = QVector4D(0, 0, 1, zs[i] * m_size.z());
+        entry->color = QVector4D(1, 1, 1, 1);
+        entry->instanceData = QVector4D();
+    }
+
+    return table;
+}
+
+QByteArray TileSeededInstancing::getInstanceBuffer(int *instanceCount)
+{
+    // The initial tile of a delegate that has not been assigned a tile yet is infinite
+    if (m_instanceCount <= 0 || !qIsFinite(m_tile.x()) || !qIsFinite(m_tile.y()) || !qIsFinite(m_tile.z())) {
+        if (instanceCount)
+            *instanceCount = 0;
+        return QByteArray();
+    }
+
+    if (instanceCount)
+        *instanceCount = m_instanceCount;
+
+    const quint64 key = tableKey();
+    QCache<quint64, QByteArray> &cache = tableCache();
+    if (const QByteArray *cached = cache.object(key))
+        return *cached;
+
+    const QByteArray table = generateTable(key);
+    cache.insert(key, new QByteArray(table), table.size());
+    return table;
+}
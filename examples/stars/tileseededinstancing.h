@@ -0,0 +1,53 @@
+#ifndef TILESEEDEDINSTANCING_H
+#define TILESEEDEDINSTANCING_H
+
+#include <QtGui/QtGui>
+#include <QtQml/qqml.h>
+#include <QtQuick3D/QQuick3DInstancing>
+
+class TileSeededInstancing : public QQuick3DInstancing
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QVector3D tile READ tile WRITE setTile NOTIFY tileChanged)
+    Q_PROPERTY(int seed READ seed WRITE setSeed NOTIFY seedChanged)
+    Q_PROPERTY(int instanceCount READ instanceCount WRITE setInstanceCount NOTIFY instanceCountChanged)
+    Q_PROPERTY(QVector3D size READ size WRITE setSize NOTIFY sizeChanged)
+
+public:
+    explicit TileSeededInstancing(QQuick3DObject *parent = nullptr);
+
+    QVector3D tile() const;
+    void setTile(const QVector3D &tile);
+
+    int seed() const;
+    void setSeed(int seed);
+
+    int instanceCount() const;
+    void setInstanceCount(int instanceCount);
+
+    QVector3D size() const;
+    void setSize(const QVector3D &size);
+
+signals:
+    void tileChanged();
+    void seedChanged();
+    void instanceCountChanged();
+    void sizeChanged();
+
+protected:
+    QByteArray getInstanceBuffer(int *instanceCount) override;
+
+private:
+    quint64 tableKey() const;
+    QByteArray generateTable(quint64 key) const;
+
+private:
+    QVector3D m_tile;
+    int m_seed = 0;
+    int m_instanceCount = 100;
+    QVector3D m_size = QVector3D(100, 100, 100);
+};
+
+#endif // TILESEEDEDINSTANCING_H
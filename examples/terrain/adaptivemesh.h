@@ -0,0 +1,248 @@
+#ifndef ADAPTIVEMESH_H
+#define ADAPTIVEMESH_H
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+/**
+ * AdaptiveMesh builds a right-triangulated irregular network (RTIN) over a grid of
+ * n * n cells, where n is a power of two. Starting with the two triangles that cover
+ * the grid, a triangle is split in two at the middle of its hypotenuse whenever the
+ * height grid deviates more than maxError from it, somewhere inside it. The error of
+ * each possible split point is calculated bottom up first, so that the mesh can then
+ * be built with a single pass top down.
+ *
+ * The grid is one tile of a larger terrain, and the vertices on its edges are shared
+ * with the neighbouring tiles, which build meshes of their own. A vertex on an edge is
+ * needed as soon as the terrain on either side of it needs it, or the triangles on that
+ * side end up with T-junctions. So the error of the triangles along each edge is also
+ * calculated for the neighbouring tile, up to bandWidth() grid points beyond the edge,
+ * just like the neighbour will calculate it itself. Both tiles then pick the same
+ * vertices along the edge they share, and the meshes line up without cracks.
+ *
+ * That only holds if the triangles that an edge vertex depends on don't reach another
+ * edge of the neighbour, so the edge vertices close to the corners are always included.
+ * So are the vertices that split edge segments longer than maxEdgeSegment.
+ *
+ * The class is header only and doesn't depend on Qt, so that it can be tested on its own.
+ */
+class AdaptiveMesh
+{
+public:
+    AdaptiveMesh(int n, float maxError, int maxEdgeSegment)
+        : m_n(n)
+        , m_maxError(maxError)
+        , m_maxEdgeSegment(maxEdgeSegment)
+    {
+    }
+
+    // The number of grid points beyond each edge that build() asks for the height of
+    int bandWidth() const { return m_maxEdgeSegment; }
+
+    /**
+     * Build the mesh, asking \a height for the height of the grid point at x, z. That
+     * includes the points up to bandWidth() beyond each edge, but not beyond the corners.
+     * Returns the corners of the triangles as x, z pairs of grid coordinates, three
+     * per triangle, counter-clockwise seen from above.
+     */
+    template<typename Height>
+    std::vector<int> build(Height height)
+    {
+        const int n = m_n;
+        const int size = n + 1;
+
+        // The tile itself, and the bands of the tiles to its left, right, bottom and top
+        const std::array<Grid, GridCount> grids = {{ { 0, 0 }, { -n, 0 }, { n, 0 }, { 0, -n }, { 0, n } }};
+        for (std::vector<float> &errors : m_errors)
+            errors.assign(size * size, 0);
+
+        // The error of the triangles on either side of each edge vertex, by its index in the tile
+        std::vector<float> sideErrors(size * size, 0);
+        std::vector<Triangle> edgeTriangles;
+
+        // Visit all the triangles the tile can be split into, from the smallest to the
+        // largest, one level at a time. Each triangle is identified by the path of left and
+        // right splits that leads to it from one of the two top level triangles.
+        int levels = 0;
+        while ((2 << levels) < 2 * n * n)
+            ++levels;
+
+        for (int level = levels; level >= 1; --level) {
+            edgeTriangles.clear();
+
+            for (int id = 1 << level; id < (2 << level); ++id) {
+                const Triangle t = triangle(id);
+                const int mx = (t.ax + t.bx) / 2;
+                const int mz = (t.az + t.bz) / 2;
+                const bool hasChildren = id < n * n;
+
+                // A split point can't be used unless all the splits leading up to it are
+                // used as well, so let the error of the smaller triangles bubble up.
+                const int apexX = mx + mz - t.az;
+                const int apexZ = mz + t.ax - mx;
+                const int left = ((t.az + apexZ) / 2) * size + (t.ax + apexX) / 2;
+                const int right = ((t.bz + apexZ) / 2) * size + (t.bx + apexX) / 2;
+
+                const bool edgeX = t.az == t.bz && (t.az == 0 || t.az == n);
+                const bool edgeZ = t.ax == t.bx && (t.ax == 0 || t.ax == n);
+
+                for (int g = 0; g < GridCount; ++g) {
+                    const Grid &grid = grids[g];
+                    if (g != Self && !(inBand(g, t.ax, t.az) && inBand(g, t.bx, t.bz) && inBand(g, t.cx, t.cz)))
+                        continue;
+
+                    std::vector<float> &errors = m_errors[g];
+                    const float childError = hasChildren ? std::max(errors[left], errors[right]) : 0;
+
+                    if (edgeX || edgeZ) {
+                        // The error of the vertices on the edges is decided below, once we know
+                        // the error on both sides. Edges of the neighbours that we don't share
+                        // with them only matter close to the corners, which are always included.
+                        if (g == Self || sharesEdge(g, t)) {
+                            const int index = (grid.z + mz) * size + (grid.x + mx);
+                            sideErrors[index] = std::max(sideErrors[index], childError);
+                            if (g == Self)
+                                edgeTriangles.push_back(t);
+                        }
+                        continue;
+                    }
+
+                    const auto h = [&](int x, int z) { return height(grid.x + x, grid.z + z); };
+                    const float interpolated = (h(t.ax, t.az) + h(t.bx, t.bz)) / 2;
+                    float &error = errors[mz * size + mx];
+                    error = std::max(error, std::max(std::abs(interpolated - h(mx, mz)), childError));
+                }
+            }
+
+            for (const Triangle &t : edgeTriangles)
+                selectEdgeVertex(t, grids, sideErrors, height);
+        }
+
+        std::vector<int> corners;
+        corners.reserve(n * n * 12);
+        addTriangle(0, 0, n, n, n, 0, &corners);
+        addTriangle(n, n, 0, 0, 0, n, &corners);
+        return corners;
+    }
+
+private:
+    enum { Self, Left, Right, Bottom, Top, GridCount };
+
+    struct Grid
+    {
+        int x;
+        int z;
+    };
+
+    struct Triangle
+    {
+        int ax, az, bx, bz, cx, cz;
+    };
+
+    Triangle triangle(int id) const
+    {
+        const int n = m_n;
+        Triangle t = { 0, 0, 0, 0, 0, 0 };
+        if (id & 1)
+            t.bx = t.bz = t.cx = n;
+        else
+            t.ax = t.az = t.cz = n;
+        while ((id >>= 1) > 1) {
+            const int mx = (t.ax + t.bx) / 2;
+            const int mz = (t.az + t.bz) / 2;
+            if (id & 1) {
+                t.bx = t.ax; t.bz = t.az;
+                t.ax = t.cx; t.az = t.cz;
+            } else {
+                t.ax = t.bx; t.az = t.bz;
+                t.bx = t.cx; t.bz = t.cz;
+            }
+            t.cx = mx;
+            t.cz = mz;
+        }
+        return t;
+    }
+
+    // Whether x, z of the neighbouring tile \a g is within bandWidth() of the edge it shares with us
+    bool inBand(int g, int x, int z) const
+    {
+        const int band = bandWidth();
+        switch (g) {
+        case Left: return x >= m_n - band;
+        case Right: return x <= band;
+        case Bottom: return z >= m_n - band;
+        case Top: return z <= band;
+        }
+        return true;
+    }
+
+    // Whether the hypotenuse of \a t lies on the edge that the neighbouring tile \a g shares with us
+    bool sharesEdge(int g, const Triangle &t) const
+    {
+        switch (g) {
+        case Left: return t.ax == m_n && t.bx == m_n;
+        case Right: return t.ax == 0 && t.bx == 0;
+        case Bottom: return t.az == m_n && t.bz == m_n;
+        case Top: return t.az == 0 && t.bz == 0;
+        }
+        return false;
+    }
+
+    template<typename Height>
+    void selectEdgeVertex(const Triangle &t, const std::array<Grid, GridCount> &grids,
+                          const std::vector<float> &sideErrors, Height height)
+    {
+        const int n = m_n;
+        const int size = n + 1;
+        const int mx = (t.ax + t.bx) / 2;
+        const int mz = (t.az + t.bz) / 2;
+        const int index = mz * size + mx;
+
+        // The edge can only be split here if the triangles on both sides can be split here
+        const int from = std::min(t.ax + t.az, t.bx + t.bz) - (t.ax == t.bx ? t.ax : t.az);
+        const int length = std::abs(t.bx - t.ax) + std::abs(t.bz - t.az);
+        const bool nearCorner = from == 0 || from + length == n;
+        const float interpolated = (height(t.ax, t.az) + height(t.bx, t.bz)) / 2;
+        const float error = std::max(std::abs(interpolated - height(mx, mz)), sideErrors[index]);
+        const bool include = error > m_maxError || length > m_maxEdgeSegment || nearCorner;
+        const float value = include ? std::numeric_limits<float>::infinity() : 0;
+
+        m_errors[Self][index] = value;
+        const int neighbour = t.ax == 0 && t.bx == 0 ? Left
+                            : t.ax == n && t.bx == n ? Right
+                            : t.az == 0 && t.bz == 0 ? Bottom
+                            : Top;
+        const Grid &grid = grids[neighbour];
+        m_errors[neighbour][(mz - grid.z) * size + (mx - grid.x)] = value;
+    }
+
+    void addTriangle(int ax, int az, int bx, int bz, int cx, int cz, std::vector<int> *corners) const
+    {
+        const int mx = (ax + bx) / 2;
+        const int mz = (az + bz) / 2;
+        if (std::abs(ax - cx) + std::abs(az - cz) > 1 && m_errors[Self][mz * (m_n + 1) + mx] > m_maxError) {
+            addTriangle(cx, cz, ax, az, mx, mz, corners);
+            addTriangle(bx, bz, cx, cz, mx, mz, corners);
+            return;
+        }
+
+        // Front face = counter-clockwise, seen from above
+        corners->insert(corners->end(), { ax, az });
+        if ((bz - az) * (cx - ax) - (bx - ax) * (cz - az) > 0)
+            corners->insert(corners->end(), { bx, bz, cx, cz });
+        else
+            corners->insert(corners->end(), { cx, cz, bx, bz });
+    }
+
+private:
+    int m_n;
+    float m_maxError;
+    int m_maxEdgeSegment;
+    std::array<std::vector<float>, GridCount> m_errors;
+};
+
+#endif // ADAPTIVEMESH_H
@@ -0,0 +1,245 @@
+#include "farfield.h"
+#include "tiletrace.h"
+#include "vertexbufferpool.h"
+
+FarField::FarField()
+{
+}
+
+FarField::~FarField()
+{
+    if (VertexBufferPool *pool = VertexBufferPool::instance())
+        pool->release(m_vertexData, m_vertexCapacity);
+}
+
+void FarField::componentComplete()
+{
+    QQuick3DGeometry::componentComplete();
+
+    setStride((3 + 2) * sizeof(float)); // Vertices + UV
+    setPrimitiveType(QQuick3DGeometry::PrimitiveType::Triangles);
+    addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
+    addAttribute(QQuick3DGeometry::Attribute::TexCoordSemantic,
+                 3 * sizeof(float),
+                 QQuick3DGeometry::Attribute::F32Type);
+
+    scheduleUpdate(true);
+}
+
+HeightSource *FarField::heightSource() const
+{
+    return m_heightSource;
+}
+
+void FarField::setHeightSource(HeightSource *heightSource)
+{
+    if (m_heightSource == heightSource)
+        return;
+
+    m_heightSource = heightSource;
+    scheduleUpdate(true);
+    emit heightSourceChanged();
+}
+
+QVector3D FarField::innerMin() const
+{
+    return m_innerMin;
+}
+
+void FarField::setInnerMin(const QVector3D &innerMin)
+{
+    if (m_innerMin == innerMin)
+        return;
+
+    m_innerMin = innerMin;
+    scheduleUpdate(false);
+    emit innerMinChanged();
+}
+
+QVector3D FarField::innerMax() const
+{
+    return m_innerMax;
+}
+
+void FarField::setInnerMax(const QVector3D &innerMax)
+{
+    if (m_innerMax == innerMax)
+        return;
+
+    m_innerMax = innerMax;
+    scheduleUpdate(false);
+    emit innerMaxChanged();
+}
+
+QVector3D FarField::size() const
+{
+    return m_size;
+}
+
+void FarField::setSize(const QVector3D &size)
+{
+    if (m_size == size)
+        return;
+
+    m_size = size;
+    scheduleUpdate(true);
+    emit sizeChanged();
+}
+
+float FarField::cellSize() const
+{
+    return m_cellSize;
+}
+
+void FarField::setCellSize(float cellSize)
+{
+    if (qFuzzyCompare(m_cellSize, cellSize))
+        return;
+
+    m_cellSize = cellSize;
+    scheduleUpdate(true);
+    emit cellSizeChanged();
+}
+
+float FarField::verticalOffset() const
+{
+    return m_verticalOffset;
+}
+
+void FarField::setVerticalOffset(float verticalOffset)
+{
+    if (qFuzzyCompare(m_verticalOffset, verticalOffset))
+        return;
+
+    m_verticalOffset = verticalOffset;
+    scheduleUpdate(true);
+    emit verticalOffsetChanged();
+}
+
+void FarField::scheduleUpdate(bool resample)
+{
+    // innerMin and innerMax typically change together when the window
+    // rolls, so wait until both have been assigned before we update.
+    m_resampleAll |= resample;
+    if (m_updatePending || !isComponentComplete())
+        return;
+
+    m_updatePending = true;
+    QMetaObject::invokeMethod(this, &FarField::updateData, Qt::QueuedConnection);
+}
+
+HeightSource *FarField::source() const
+{
+    return m_heightSource ? m_heightSource.data() : HeightSource::defaultSource();
+}
+
+float FarField::sampleHeight(const TileGrid<2>::Coord &sample) const
+{
+    return source()->sampleHeight(sample[0] * m_cellSize, sample[1] * m_cellSize) + m_verticalOffset;
+}
+
+void FarField::updateData()
+{
+    m_updatePending = false;
+    if (m_cellSize <= 0)
+        return;
+
+    TILE_TRACE_SCOPE("FarField::updateData", "center", (m_innerMin + m_innerMax) / 2);
+    QElapsedTimer timer;
+    timer.start();
+
+    // The samples are aligned to a world space grid of cellSize, and cover
+    // an area of the given size centered around the center of the window.
+    const TileGrid<2>::Coord count = { qCeil(m_size.x() / m_cellSize) + 1, qCeil(m_size.z() / m_cellSize) + 1 };
+    const QVector3D center = (m_innerMin + m_innerMax) / 2;
+    const TileGrid<2>::Coord origin = { qFloor(center.x() / m_cellSize) - count[0] / 2,
+                                        qFloor(center.z() / m_cellSize) - count[1] / 2 };
+
+    if (m_resampleAll || m_samples.count() != count) {
+        m_samples.reset(count, origin);
+        m_heights.resize(m_samples.cellCount());
+        m_samples.forEachCell([this](const TileGrid<2>::Cell &cell) {
+            m_heights[cell.index] = sampleHeight(cell.tileCoord);
+        });
+        m_resampleAll = false;
+    } else {
+        std::vector<TileGrid<2>::Cell> changed;
+        m_samples.moveTo(origin, &changed);
+        for (const TileGrid<2>::Cell &cell : changed)
+            m_heights[cell.index] = sampleHeight(cell.tileCoord);
+    }
+
+    // Build the ring out of the cells between the samples. Cells that are completely covered
+    // by the window are left out, except for the outermost row of them, so that the real tiles
+    // overlap the inner edge of the ring and hide it.
+    const int innerFromX = qCeil(m_innerMin.x() / m_cellSize) + 1;
+    const int innerFromZ = qCeil(m_innerMin.z() / m_cellSize) + 1;
+    const int innerToX = qFloor(m_innerMax.x() / m_cellSize) - 1;
+    const int innerToZ = qFloor(m_innerMax.z() / m_cellSize) - 1;
+
+    // Between the samples the ring is flat, while the terrain of the tiles above it can bulge
+    // up or sag down. So wherever a cell reaches into the window, its corners are lowered by
+    // as much as the terrain can differ across a cell, to keep the ring below the tiles.
+    const int coveredFromX = qFloor(m_innerMin.x() / m_cellSize);
+    const int coveredFromZ = qFloor(m_innerMin.z() / m_cellSize);
+    const int coveredToX = qCeil(m_innerMax.x() / m_cellSize);
+    const int coveredToZ = qCeil(m_innerMax.z() / m_cellSize);
+    const float coveredDrop = source()->maximumDifference(m_cellSize);
+
+    const int maxCellCount = (count[0] - 1) * (count[1] - 1);
+    const int vertexCountPerSquare = 6; // two triangles
+
+    // The previous buffer is still shared with the geometry (and the renderer), so
+    // writing to it would make a copy. Build into a buffer from the pool instead.
+    VertexBufferPool *pool = VertexBufferPool::instance();
+    QByteArray previousVertexData = m_vertexData;
+    const int previousCapacity = m_vertexCapacity;
+    m_vertexCapacity = maxCellCount * vertexCountPerSquare * stride();
+    m_vertexData = pool->acquire(m_vertexCapacity);
+    m_vertexData.resize(m_vertexCapacity);
+    float *p = reinterpret_cast<float *>(m_vertexData.data());
+
+    float minHeight = std::numeric_limits<float>::max();
+    float maxHeight = std::numeric_limits<float>::lowest();
+
+    auto vertex = [&](int x, int z) {
+        const bool covered = x >= coveredFromX && x <= coveredToX && z >= coveredFromZ && z <= coveredToZ;
+        const float height = m_heights[m_samples.indexOf(m_samples.matrixCoordOf({ x, z }))] - (covered ? coveredDrop : 0);
+        minHeight = qMin(minHeight, height);
+        maxHeight = qMax(maxHeight, height);
+        *p++ = x * m_cellSize;
+        *p++ = height;
+        *p++ = z * m_cellSize;
+        *p++ = x * m_cellSize;
+        *p++ = z * m_cellSize;
+    };
+
+    const TileGrid<2>::Coord from = m_samples.originTile();
+    const TileGrid<2>::Coord to = m_samples.cornerTile();
+    int cellCount = 0;
+
+    // Front face = counter-clockwise
+    for (int x = from[0]; x < to[0]; ++x) {
+        for (int z = from[1]; z < to[1]; ++z) {
+            if (x >= innerFromX && x + 1 <= innerToX && z >= innerFromZ && z + 1 <= innerToZ)
+                continue;
+
+            vertex(x + 1, z + 1);
+            vertex(x + 1, z);
+            vertex(x, z + 1);
+
+            vertex(x, z + 1);
+            vertex(x + 1, z);
+            vertex(x, z);
+            ++cellCount;
+        }
+    }
+
+    m_vertexData.resize(cellCount * vertexCountPerSquare * stride());
+    setBounds(QVector3D(from[0] * m_cellSize, minHeight, from[1] * m_cellSize),
+              QVector3D(to[0] * m_cellSize, maxHeight, to[1] * m_cellSize));
+    setVertexData(m_vertexData);
+    pool->release(previousVertexData, previousCapacity);
+    update();
+    source()->addGenerationTime(timer.nsecsElapsed());
+}
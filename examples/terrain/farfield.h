@@ -0,0 +1,80 @@
+#ifndef FARFIELD_H
+#define FARFIELD_H
+
+#include <QtGui/QtGui>
+#include <QQuick3DGeometry>
+
+#include "heightsource.h"
+#include "tilegrid.h"
+
+class FarField : public QQuick3DGeometry
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(HeightSource *heightSource READ heightSource WRITE setHeightSource NOTIFY heightSourceChanged)
+    Q_PROPERTY(QVector3D innerMin READ innerMin WRITE setInnerMin NOTIFY innerMinChanged)
+    Q_PROPERTY(QVector3D innerMax READ innerMax WRITE setInnerMax NOTIFY innerMaxChanged)
+    Q_PROPERTY(QVector3D size READ size WRITE setSize NOTIFY sizeChanged)
+    Q_PROPERTY(float cellSize READ cellSize WRITE setCellSize NOTIFY cellSizeChanged)
+    Q_PROPERTY(float verticalOffset READ verticalOffset WRITE setVerticalOffset NOTIFY verticalOffsetChanged)
+
+public:
+    FarField();
+    ~FarField() override;
+
+    HeightSource *heightSource() const;
+    void setHeightSource(HeightSource *heightSource);
+
+    QVector3D innerMin() const;
+    void setInnerMin(const QVector3D &innerMin);
+
+    QVector3D innerMax() const;
+    void setInnerMax(const QVector3D &innerMax);
+
+    QVector3D size() const;
+    void setSize(const QVector3D &size);
+
+    float cellSize() const;
+    void setCellSize(float cellSize);
+
+    float verticalOffset() const;
+    void setVerticalOffset(float verticalOffset);
+
+signals:
+    void heightSourceChanged();
+    void innerMinChanged();
+    void innerMaxChanged();
+    void sizeChanged();
+    void cellSizeChanged();
+    void verticalOffsetChanged();
+
+protected:
+    void componentComplete() override;
+
+private:
+    void scheduleUpdate(bool resample);
+    void updateData();
+    HeightSource *source() const;
+    float sampleHeight(const TileGrid<2>::Coord &sample) const;
+
+private:
+    QPointer<HeightSource> m_heightSource;
+    QVector3D m_innerMin;
+    QVector3D m_innerMax;
+    QVector3D m_size = QVector3D(10000, 0, 10000);
+    float m_cellSize = 200;
+    float m_verticalOffset = -10;
+
+    // The height samples are stored in a ring buffer that follows the inner window, so that
+    // only the rows and columns that scroll into view need to be sampled when the window moves.
+    TileGrid<2> m_samples;
+    QVector<float> m_heights;
+    bool m_resampleAll = true;
+    bool m_updatePending = false;
+
+    QByteArray m_vertexData;
+    int m_vertexCapacity = 0;
+};
+
+#endif // FARFIELD_H
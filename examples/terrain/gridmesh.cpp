@@ -0,0 +1,117 @@
+#include "gridmesh.h"
+
+GridMesh::GridMesh()
+{
+}
+
+void GridMesh::componentComplete()
+{
+    QQuick3DGeometry::componentComplete();
+
+    setStride((3 + 2) * sizeof(float)); // Vertices + UV
+    setPrimitiveType(QQuick3DGeometry::PrimitiveType::Triangles);
+    addAttribute(QQuick3DGeometry::Attribute::PositionSemantic, 0, QQuick3DGeometry::Attribute::F32Type);
+    addAttribute(QQuick3DGeometry::Attribute::TexCoordSemantic,
+                 3 * sizeof(float),
+                 QQuick3DGeometry::Attribute::F32Type);
+    addAttribute(QQuick3DGeometry::Attribute::IndexSemantic, 0, QQuick3DGeometry::Attribute::U32Type);
+
+    updateData();
+}
+
+QVector3D GridMesh::tileSize() const
+{
+    return m_tileSize;
+}
+
+void GridMesh::setTileSize(QVector3D tileSize)
+{
+    if (m_tileSize == tileSize)
+        return;
+
+    m_tileSize = tileSize;
+    updateData();
+    emit tileSizeChanged();
+}
+
+QVector3D GridMesh::resolution() const
+{
+    return m_resolution;
+}
+
+void GridMesh::setResolution(QVector3D resolution)
+{
+    if (m_resolution == resolution)
+        return;
+
+    m_resolution = resolution;
+    updateData();
+    emit resolutionChanged();
+}
+
+HeightSource *GridMesh::heightSource() const
+{
+    return m_heightSource;
+}
+
+/**
+ * The mesh doesn't sample the height source, but uses its height
+ * range as the bounds, since that's how far it can be displaced.
+ */
+void GridMesh::setHeightSource(HeightSource *heightSource)
+{
+    if (m_heightSource == heightSource)
+        return;
+
+    m_heightSource = heightSource;
+    updateData();
+    emit heightSourceChanged();
+}
+
+void GridMesh::updateData()
+{
+    if (!isComponentComplete())
+        return;
+
+    const int resolutionX = qMax(1, int(m_resolution.x()));
+    const int resolutionZ = qMax(1, int(m_resolution.z()));
+    const float distX = m_tileSize.x() / resolutionX;
+    const float distZ = m_tileSize.z() / resolutionZ;
+
+    QByteArray vertexData((resolutionX + 1) * (resolutionZ + 1) * stride(), Qt::Uninitialized);
+    float *p = reinterpret_cast<float *>(vertexData.data());
+    for (int z = 0; z <= resolutionZ; ++z) {
+        for (int x = 0; x <= resolutionX; ++x) {
+            *p++ = x * distX;
+            *p++ = 0;
+            *p++ = z * distZ;
+            *p++ = float(x) / resolutionX;
+            *p++ = float(z) / resolutionZ;
+        }
+    }
+
+    QByteArray indexData(resolutionX * resolutionZ * 6 * sizeof(quint32), Qt::Uninitialized);
+    quint32 *i = reinterpret_cast<quint32 *>(indexData.data());
+    const auto vertex = [=](int x, int z) { return quint32(z * (resolutionX + 1) + x); };
+
+    // Front face = counter-clockwise
+    for (int x = 0; x < resolutionX; ++x) {
+        for (int z = 0; z < resolutionZ; ++z) {
+            *i++ = vertex(x + 1, z + 1);
+            *i++ = vertex(x + 1, z);
+            *i++ = vertex(x, z + 1);
+
+            *i++ = vertex(x, z + 1);
+            *i++ = vertex(x + 1, z);
+            *i++ = vertex(x, z);
+        }
+    }
+
+    HeightSource *heightSource = m_heightSource ? m_heightSource.data() : HeightSource::defaultSource();
+    setBounds(QVector3D(0, heightSource->minimumHeight(), 0),
+              QVector3D(m_tileSize.x(), heightSource->maximumHeight(), m_tileSize.z()));
+
+    setVertexData(vertexData);
+    setIndexData(indexData);
+    update();
+}
@@ -0,0 +1,52 @@
+#ifndef GRIDMESH_H
+#define GRIDMESH_H
+
+#include <QtGui/QtGui>
+#include <QQuick3DGeometry>
+
+#include "heightsource.h"
+
+/**
+ * GridMesh is a flat grid that covers one tile, for all tiles to share. The heights
+ * come from a HeightMap per tile instead, which the material displaces the grid by.
+ * The UV of each vertex is its position in the grid, from 0 to 1 along x and z.
+ */
+class GridMesh : public QQuick3DGeometry
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QVector3D tileSize READ tileSize WRITE setTileSize NOTIFY tileSizeChanged)
+    Q_PROPERTY(QVector3D resolution READ resolution WRITE setResolution NOTIFY resolutionChanged)
+    Q_PROPERTY(HeightSource *heightSource READ heightSource WRITE setHeightSource NOTIFY heightSourceChanged)
+
+public:
+    GridMesh();
+
+    QVector3D tileSize() const;
+    void setTileSize(QVector3D tileSize);
+
+    QVector3D resolution() const;
+    void setResolution(QVector3D resolution);
+
+    HeightSource *heightSource() const;
+    void setHeightSource(HeightSource *heightSource);
+
+signals:
+    void tileSizeChanged();
+    void resolutionChanged();
+    void heightSourceChanged();
+
+protected:
+    void componentComplete() override;
+
+private:
+    void updateData();
+
+private:
+    QVector3D m_tileSize = QVector3D(100, 100, 100);
+    QVector3D m_resolution = QVector3D(10, 10, 10);
+    QPointer<HeightSource> m_heightSource;
+};
+
+#endif // GRIDMESH_H
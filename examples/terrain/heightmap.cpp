@@ -0,0 +1,166 @@
+#include "heightmap.h"
+#include "tiletrace.h"
+#include "vertexbufferpool.h"
+
+HeightMap::HeightMap()
+{
+}
+
+HeightMap::~HeightMap()
+{
+    if (VertexBufferPool *pool = VertexBufferPool::instance())
+        pool->release(m_textureData, m_textureCapacity);
+}
+
+void HeightMap::componentComplete()
+{
+    QQuick3DTextureData::componentComplete();
+
+    setFormat(QQuick3DTextureData::R32F);
+    updateData();
+}
+
+QVector3D HeightMap::tileSize() const
+{
+    return m_tileSize;
+}
+
+void HeightMap::setTileSize(QVector3D tileSize)
+{
+    if (m_tileSize == tileSize)
+        return;
+
+    m_tileSize = tileSize;
+    scheduleUpdate();
+    emit tileSizeChanged();
+}
+
+QVector3D HeightMap::resolution() const
+{
+    return m_resolution;
+}
+
+/**
+ * The number of grid cells along x and z. This needs to match the
+ * resolution of the GridMesh that the height map is used with.
+ */
+void HeightMap::setResolution(QVector3D resolution)
+{
+    if (m_resolution == resolution)
+        return;
+
+    m_resolution = resolution;
+    scheduleUpdate();
+    emit resolutionChanged();
+}
+
+QVector3D HeightMap::position() const
+{
+    return m_position;
+}
+
+void HeightMap::setPosition(QVector3D position)
+{
+    if (m_position == position)
+        return;
+
+    m_position = position;
+    scheduleUpdate();
+    emit positionChanged();
+}
+
+QVector3D HeightMap::boundsMin() const
+{
+    return m_boundsMin;
+}
+
+QVector3D HeightMap::boundsMax() const
+{
+    return m_boundsMax;
+}
+
+HeightSource *HeightMap::heightSource() const
+{
+    return m_heightSource;
+}
+
+void HeightMap::setHeightSource(HeightSource *heightSource)
+{
+    if (m_heightSource == heightSource)
+        return;
+
+    m_heightSource = heightSource;
+    scheduleUpdate();
+    emit heightSourceChanged();
+}
+
+HeightSource *HeightMap::source() const
+{
+    return m_heightSource ? m_heightSource.data() : HeightSource::defaultSource();
+}
+
+/**
+ * Like LandTile, we wait for the event loop before sampling the heights
+ * again, so that properties that change together only cause one update.
+ */
+void HeightMap::scheduleUpdate()
+{
+    if (m_updatePending || !isComponentComplete())
+        return;
+
+    m_updatePending = true;
+    QMetaObject::invokeMethod(this, &HeightMap::updateData, Qt::QueuedConnection);
+}
+
+void HeightMap::updateData()
+{
+    m_updatePending = false;
+    if (!isComponentComplete())
+        return;
+
+    TILE_TRACE_SCOPE("HeightMap::updateData", "position", m_position);
+    QElapsedTimer timer;
+    timer.start();
+
+    const int resolutionX = qMax(1, int(m_resolution.x()));
+    const int resolutionZ = qMax(1, int(m_resolution.z()));
+    const float distX = m_tileSize.x() / resolutionX;
+    const float distZ = m_tileSize.z() / resolutionZ;
+
+    // One sample per grid point, plus the border
+    const int width = resolutionX + 3;
+    const int height = resolutionZ + 3;
+
+    // The texture data is shared with the renderer until it has been uploaded,
+    // so it goes through the same pool as the vertex buffers of the LandTiles.
+    VertexBufferPool *pool = VertexBufferPool::instance();
+    QByteArray previousTextureData = m_textureData;
+    const int previousCapacity = m_textureCapacity;
+    m_textureCapacity = width * height * sizeof(float);
+    m_textureData = pool->acquire(m_textureCapacity);
+    m_textureData.resize(m_textureCapacity);
+
+    HeightSource *heightSource = source();
+    float *p = reinterpret_cast<float *>(m_textureData.data());
+    float minHeight = std::numeric_limits<float>::max();
+    float maxHeight = std::numeric_limits<float>::lowest();
+    for (int z = 0; z < height; ++z) {
+        for (int x = 0; x < width; ++x) {
+            const float posX = m_position.x() + (x - 1) * distX;
+            const float posZ = m_position.z() + (z - 1) * distZ;
+            const float sample = heightSource->sampleHeight(posX, posZ);
+            *p++ = sample;
+            minHeight = qMin(minHeight, sample);
+            maxHeight = qMax(maxHeight, sample);
+        }
+    }
+
+    setSize(QSize(width, height));
+    setTextureData(m_textureData);
+    pool->release(previousTextureData, previousCapacity);
+
+    m_boundsMin = QVector3D(0, minHeight, 0);
+    m_boundsMax = QVector3D(m_tileSize.x(), maxHeight, m_tileSize.z());
+    heightSource->addGenerationTime(timer.nsecsElapsed());
+    emit boundsChanged();
+}
@@ -0,0 +1,76 @@
+#ifndef HEIGHTMAP_H
+#define HEIGHTMAP_H
+
+#include <QtGui/QtGui>
+#include <QQuick3DTextureData>
+
+#include "heightsource.h"
+
+/**
+ * HeightMap is the height grid of one tile as a single channel float texture, for
+ * displacing a GridMesh on the GPU. Compared to a LandTile, assigning a new tile only
+ * means uploading the heights, rather than a full vertex buffer.
+ *
+ * The texture has a border of one sample around the tile, so that the shader can
+ * calculate the normals along the edges the same way as the neighbouring tiles do.
+ */
+class HeightMap : public QQuick3DTextureData
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QVector3D tileSize READ tileSize WRITE setTileSize NOTIFY tileSizeChanged)
+    Q_PROPERTY(QVector3D resolution READ resolution WRITE setResolution NOTIFY resolutionChanged)
+    Q_PROPERTY(QVector3D position READ position WRITE setPosition NOTIFY positionChanged)
+    Q_PROPERTY(QVector3D boundsMin READ boundsMin NOTIFY boundsChanged)
+    Q_PROPERTY(QVector3D boundsMax READ boundsMax NOTIFY boundsChanged)
+    Q_PROPERTY(HeightSource *heightSource READ heightSource WRITE setHeightSource NOTIFY heightSourceChanged)
+
+public:
+    HeightMap();
+    ~HeightMap() override;
+
+    QVector3D tileSize() const;
+    void setTileSize(QVector3D tileSize);
+
+    QVector3D resolution() const;
+    void setResolution(QVector3D resolution);
+
+    QVector3D position() const;
+    void setPosition(QVector3D position);
+
+    QVector3D boundsMin() const;
+    QVector3D boundsMax() const;
+
+    HeightSource *heightSource() const;
+    void setHeightSource(HeightSource *heightSource);
+
+signals:
+    void tileSizeChanged();
+    void resolutionChanged();
+    void positionChanged();
+    void boundsChanged();
+    void heightSourceChanged();
+
+protected:
+    void componentComplete() override;
+
+private:
+    HeightSource *source() const;
+    void scheduleUpdate();
+    void updateData();
+
+private:
+    QVector3D m_position;
+    QVector3D m_tileSize = QVector3D(100, 100, 100);
+    QVector3D m_resolution = QVector3D(10, 10, 10);
+    QVector3D m_boundsMin;
+    QVector3D m_boundsMax;
+    QPointer<HeightSource> m_heightSource;
+
+    QByteArray m_textureData;
+    int m_textureCapacity = 0;
+    bool m_updatePending = false;
+};
+
+#endif // HEIGHTMAP_H
@@ -0,0 +1,273 @@
+#include "heightsource.h"
+#include "landtile.h"
+
+static const float s_octaveHeights[] = { 200, 10, 1 };
+static const float s_octaveScales[] = { 0.001f, 0.02f, 0.1f };
+static const int s_octaveCount = 3;
+
+// The steepest slope of a single octave of noise (with a height and scale of 1). It's
+// a bit more than what we measured (just under 1.4), so that we don't overshoot a hit.
+static const float s_noiseSlope = 1.5f;
+
+// The smallest step when marching a ray against the noise directly. This should be
+// smaller than the features of the finest octave to not miss any hits.
+static const float s_minimumMarchStep = 1.0f;
+
+Q_GLOBAL_STATIC(HeightSource, s_defaultSource)
+
+HeightSource::HeightSource(QObject *parent)
+    : QObject(parent)
+{
+}
+
+HeightSource *HeightSource::defaultSource()
+{
+    return s_defaultSource();
+}
+
+float HeightSource::sampleHeight(float x, float z)
+{
+    qreal height = 0;
+    for (int i = 0; i < s_octaveCount; ++i) {
+        const qreal scale = s_octaveScales[i];
+        height += m_perlin.noise(x * scale, z * scale, 0.1) * s_octaveHeights[i];
+    }
+    return height;
+}
+
+float HeightSource::minimumHeight() const
+{
+    return 0;
+}
+
+float HeightSource::maximumHeight() const
+{
+    float height = 0;
+    for (int i = 0; i < s_octaveCount; ++i)
+        height += s_octaveHeights[i];
+    return height;
+}
+
+/**
+ * Returns how much the height can change at most per unit of distance in the xz plane.
+ */
+float HeightSource::maximumSlope() const
+{
+    float slope = 0;
+    for (int i = 0; i < s_octaveCount; ++i)
+        slope += s_octaveHeights[i] * s_octaveScales[i] * s_noiseSlope;
+    return slope;
+}
+
+/**
+ * Returns how much the height can differ at most between two points that are \a distance
+ * apart in the xz plane. The finer octaves can't add more than their whole range to it.
+ */
+float HeightSource::maximumDifference(float distance) const
+{
+    float difference = 0;
+    for (int i = 0; i < s_octaveCount; ++i)
+        difference += qMin(s_octaveHeights[i] * s_octaveScales[i] * s_noiseSlope * distance, 2 * s_octaveHeights[i]);
+    return difference;
+}
+
+/**
+ * Returns a hash of the settings that the heights depend on. Content that is
+ * generated from the heights can use it to tell if it's still up to date.
+ */
+QByteArray HeightSource::settingsHash() const
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(s_octaveHeights), sizeof(s_octaveHeights)));
+    hash.addData(QByteArray::fromRawData(reinterpret_cast<const char *>(s_octaveScales), sizeof(s_octaveScales)));
+    return hash.result();
+}
+
+/**
+ * Returns the height of the terrain at the given position. If the tile that covers the
+ * position has already been generated, the height will be interpolated from its height
+ * grid. Otherwise we fall back to sampling the noise directly.
+ */
+float HeightSource::heightAt(float x, float z)
+{
+    if (LandTile *tile = m_tiles.value(mapPositionToTileKey(x, z)))
+        return tile->heightAt(x, z);
+    return sampleHeight(x, z);
+}
+
+/**
+ * Returns the distance along \a direction from \a origin to the first point where the ray
+ * hits the terrain, or -1 if it doesn't hit it within \a maxDistance. The ray walks the tiles
+ * it passes over from near to far, and uses the generated tiles where available.
+ */
+float HeightSource::raycast(const QVector3D &origin, const QVector3D &direction, float maxDistance)
+{
+    const QVector3D dir = direction.normalized();
+    if (dir.isNull())
+        return -1;
+
+    float distance = 0;
+
+    if (m_tiles.isEmpty())
+        return raycastSource(origin, dir, 0, maxDistance, &distance) ? distance : -1;
+
+    // Walk the tiles that the ray passes over in the xz plane (Amanatides & Woo)
+    const float infinity = std::numeric_limits<float>::infinity();
+    QPoint key = mapPositionToTileKey(origin.x(), origin.z());
+
+    const int stepX = dir.x() > 0 ? 1 : -1;
+    const int stepZ = dir.z() > 0 ? 1 : -1;
+    const float edgeX = m_tileOrigin.x() + (key.x() + (stepX > 0 ? 1 : 0)) * m_tileSize.x();
+    const float edgeZ = m_tileOrigin.y() + (key.y() + (stepZ > 0 ? 1 : 0)) * m_tileSize.y();
+    float nextX = qFuzzyIsNull(dir.x()) ? infinity : (edgeX - origin.x()) / dir.x();
+    float nextZ = qFuzzyIsNull(dir.z()) ? infinity : (edgeZ - origin.z()) / dir.z();
+    const float deltaX = qFuzzyIsNull(dir.x()) ? infinity : m_tileSize.x() / qAbs(dir.x());
+    const float deltaZ = qFuzzyIsNull(dir.z()) ? infinity : m_tileSize.y() / qAbs(dir.z());
+
+    float from = 0;
+    while (from < maxDistance) {
+        const float to = qMin(qMin(nextX, nextZ), maxDistance);
+        const LandTile *tile = m_tiles.value(key);
+        const bool hit = tile ? tile->intersectRay(origin, dir, from, to, &distance)
+                              : raycastSource(origin, dir, from, to, &distance);
+        if (hit)
+            return distance;
+
+        if (nextX < nextZ) {
+            key.rx() += stepX;
+            from = nextX;
+            nextX += deltaX;
+        } else {
+            key.ry() += stepZ;
+            from = nextZ;
+            nextZ += deltaZ;
+        }
+    }
+
+    return -1;
+}
+
+bool HeightSource::raycastSource(const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance)
+{
+    // Only the part of the ray that lies between the lowest and
+    // the highest height that the noise can produce can hit anything.
+    const float minHeight = minimumHeight();
+    const float maxHeight = maximumHeight();
+    if (qFuzzyIsNull(direction.y())) {
+        if (origin.y() < minHeight || origin.y() > maxHeight)
+            return false;
+    } else {
+        float enter = (minHeight - origin.y()) / direction.y();
+        float exit = (maxHeight - origin.y()) / direction.y();
+        if (enter > exit)
+            std::swap(enter, exit);
+        from = qMax(from, enter);
+        to = qMin(to, exit);
+    }
+
+    if (from > to)
+        return false;
+
+    auto heightAbove = [&](float t) {
+        const QVector3D p = origin + direction * t;
+        return p.y() - sampleHeight(p.x(), p.z());
+    };
+
+    float height = heightAbove(from);
+    if (height <= 0) {
+        *distance = from;
+        return true;
+    }
+
+    // The ray gets closer to the ground by at most this much per unit of distance
+    // along it. If it climbs faster than the terrain can, it will never hit it.
+    const float horizontal = std::sqrt(direction.x() * direction.x() + direction.z() * direction.z());
+    const float approach = maximumSlope() * horizontal - direction.y();
+    if (approach <= 0)
+        return false;
+
+    // March along the ray until we end up below the ground, and then refine the last
+    // step to find where we crossed it. While we're high above the ground, we can take
+    // big steps, since the ground can't rise fast enough to be hit before the next one.
+    float above = from;
+    while (above < to) {
+        float below = qMin(above + qMax(height / approach, s_minimumMarchStep), to);
+        height = heightAbove(below);
+        if (height <= 0) {
+            for (int i = 0; i < 8; ++i) {
+                const float mid = (above + below) / 2;
+                if (heightAbove(mid) <= 0)
+                    below = mid;
+                else
+                    above = mid;
+            }
+            *distance = below;
+            return true;
+        }
+        above = below;
+    }
+
+    return false;
+}
+
+QPoint HeightSource::mapPositionToTileKey(float x, float z) const
+{
+    if (m_tileSize.isNull())
+        return QPoint();
+    return QPoint(qFloor((x - m_tileOrigin.x()) / m_tileSize.x()),
+                  qFloor((z - m_tileOrigin.y()) / m_tileSize.y()));
+}
+
+void HeightSource::addTile(LandTile *tile)
+{
+    removeTile(tile);
+
+    const QVector2D position(tile->position().x(), tile->position().z());
+    const QVector2D tileSize(tile->tileSize().x(), tile->tileSize().z());
+
+    if (tileSize != m_tileSize) {
+        // We expect all tiles to be of the same size, and to be aligned
+        // to the same grid. Start over if that is no longer the case.
+        m_tiles.clear();
+        m_tileKeys.clear();
+        m_tileSize = tileSize;
+        m_tileOrigin = position;
+    }
+
+    const QVector2D tileCoord = (position - m_tileOrigin) / m_tileSize;
+    const QPoint key(qRound(tileCoord.x()), qRound(tileCoord.y()));
+    m_tiles.insert(key, tile);
+    m_tileKeys.insert(tile, key);
+}
+
+void HeightSource::removeTile(LandTile *tile)
+{
+    const auto it = m_tileKeys.constFind(tile);
+    if (it == m_tileKeys.constEnd())
+        return;
+
+    if (m_tiles.value(it.value()) == tile)
+        m_tiles.remove(it.value());
+    m_tileKeys.erase(it);
+}
+
+/**
+ * Adds \a nsecs to the time spent generating content from this source. Unlike the
+ * frame time, which vsync holds at the refresh interval, it keeps growing with the
+ * amount of work, so it can tell a TileQualityController how much time there is to spare.
+ */
+void HeightSource::addGenerationTime(qint64 nsecs)
+{
+    m_generationTime += nsecs;
+}
+
+/**
+ * Returns the time in milliseconds spent generating content from
+ * this source since the last call, and starts counting from zero.
+ */
+qreal HeightSource::takeGenerationTime()
+{
+    const qreal milliseconds = m_generationTime / 1e6;
+    m_generationTime = 0;
+    return milliseconds;
+}
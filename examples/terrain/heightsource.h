@@ -0,0 +1,52 @@
+#ifndef HEIGHTSOURCE_H
+#define HEIGHTSOURCE_H
+
+#include <QtGui/QtGui>
+#include <QtQml/qqml.h>
+
+#include "perlinnoise.h"
+
+class LandTile;
+
+class HeightSource : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+public:
+    explicit HeightSource(QObject *parent = nullptr);
+
+    static HeightSource *defaultSource();
+
+    Q_INVOKABLE float sampleHeight(float x, float z);
+    Q_INVOKABLE float heightAt(float x, float z);
+    Q_INVOKABLE float raycast(const QVector3D &origin, const QVector3D &direction, float maxDistance = 10000);
+
+    float minimumHeight() const;
+    float maximumHeight() const;
+    float maximumSlope() const;
+    float maximumDifference(float distance) const;
+    QByteArray settingsHash() const;
+
+    void addTile(LandTile *tile);
+    void removeTile(LandTile *tile);
+
+    void addGenerationTime(qint64 nsecs);
+    Q_INVOKABLE qreal takeGenerationTime();
+
+private:
+    QPoint mapPositionToTileKey(float x, float z) const;
+    bool raycastSource(const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance);
+
+private:
+    PerlinNoise m_perlin;
+
+    QVector2D m_tileOrigin;
+    QVector2D m_tileSize;
+    QHash<QPoint, LandTile *> m_tiles;
+    QHash<LandTile *, QPoint> m_tileKeys;
+
+    qint64 m_generationTime = 0;
+};
+
+#endif // HEIGHTSOURCE_H
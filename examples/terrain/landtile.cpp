@@ -1,12 +1,34 @@
 #include "landtile.h"
+#include "adaptivemesh.h"
+#include "tiletrace.h"
+#include "vertexbufferpool.h"
 
-#define COORD(v) *p++ = v.x(); *p++ = getHeight(v); *p++ = v.y()
-#define UV(v) *p++ = v.x(); *p++ = v.y()
+#define COORD(gx, gz) *p++ = (gx) * distX; *p++ = gridHeight(gx, gz); *p++ = (gz) * distZ
+#define UV(gx, gz) *p++ = (gx) * distX + m_position.x(); *p++ = (gz) * distZ + m_position.z()
+
+// Bump this when the format of the entries in the disk cache changes
+static const int s_diskCacheVersion = 2;
+
+// The number of levels of maxError per doubling that meshes are built for (see setMaxError)
+static const float s_maxErrorLevelsPerOctave = 2;
+
+// The longest run of grid cells along a tile edge that the adaptive mesh
+// will cover with one triangle, no matter how flat the terrain is there.
+static const int s_maxEdgeSegment = 8;
 
 LandTile::LandTile()
 {
 }
 
+LandTile::~LandTile()
+{
+    // The default height source is gone already when tiles outlive it at exit
+    if (HeightSource *heightSource = source())
+        heightSource->removeTile(this);
+    if (VertexBufferPool *pool = VertexBufferPool::instance())
+        pool->release(m_vertexData, m_vertexCapacity);
+}
+
 void LandTile::componentComplete()
 {
     QQuick3DGeometry::componentComplete();
@@ -27,13 +49,6 @@ void LandTile::recreate()
                  3 * sizeof(float),
                  QQuick3DGeometry::Attribute::F32Type);
 
-    const int vertexCountPerSquare = 6; // two triangles
-    const int vertexCount = m_resolution.x() * m_resolution.z() * vertexCountPerSquare;
-    const int bufferSize = vertexCount * stride();
-
-    if (m_vertexData.size() != bufferSize)
-        m_vertexData.resize(vertexCount * stride());
-
     updateData();
     markAllDirty();
 }
@@ -49,7 +64,7 @@ void LandTile::setTileSize(QVector3D tileSize)
         return;
 
     m_tileSize = tileSize;
-    updateData();
+    scheduleUpdate();
     emit tileSizeChanged();
 }
 
@@ -64,7 +79,7 @@ void LandTile::setResolution(QVector3D resolution)
         return;
 
     m_resolution = resolution;
-    recreate();
+    scheduleUpdate();
     emit resolutionChanged();
 }
 
@@ -79,85 +94,544 @@ void LandTile::setPosition(QVector3D position)
         return;
 
     m_position = position;
-    updateData();
+    scheduleUpdate();
     emit positionChanged();
 }
 
-QVector3D LandTile::sampleScale() const
+float LandTile::maxError() const
 {
-    return m_sampleScale;
+    return m_maxError;
 }
 
-void LandTile::setSampleScale(QVector3D sampleScale)
+/**
+ * When maxError is larger than 0, the tile is drawn with an adaptive mesh that only
+ * uses as many triangles as it needs to keep the terrain within about maxError of the
+ * height grid (in world units, vertically). The height grid is then rounded up to the
+ * nearest power of two cells along both axes, which is what the mesh is built from.
+ * When maxError is 0 (the default), every cell of the grid is drawn as two triangles.
+ * Note that heightAt() and raycast() always use the full height grid.
+ *
+ * The mesh is built for the nearest of a few fixed levels of maxError (a factor of
+ * sqrt(2) apart), so that a maxError that follows the quality of the view doesn't
+ * rebuild the tiles, or miss the disk cache, for every small change.
+ *
+ * Neighbouring tiles need to use the same resolution and maxError for their
+ * adaptive meshes to line up along the edges.
+ */
+void LandTile::setMaxError(float maxError)
 {
-    if (m_sampleScale == sampleScale)
+    if (qFuzzyCompare(m_maxError, maxError))
         return;
 
-    m_sampleScale = sampleScale;
-    updateData();
-    emit sampleScaleChanged();
+    m_maxError = maxError;
+    scheduleUpdate();
+    emit maxErrorChanged();
+}
+
+HeightSource *LandTile::heightSource() const
+{
+    return m_heightSource;
+}
+
+void LandTile::setHeightSource(HeightSource *heightSource)
+{
+    if (m_heightSource == heightSource)
+        return;
+
+    source()->removeTile(this);
+    m_heightSource = heightSource;
+    scheduleUpdate();
+    emit heightSourceChanged();
+}
+
+/**
+ * The mesh is not regenerated right away when a property changes, since several of them
+ * typically change together (like when a tile is assigned, or while the bindings are set
+ * up). Instead we regenerate it once from the event loop, after all of them have changed.
+ */
+void LandTile::scheduleUpdate()
+{
+    if (m_updatePending || !isComponentComplete())
+        return;
+
+    m_updatePending = true;
+    QMetaObject::invokeMethod(this, &LandTile::updateData, Qt::QueuedConnection);
+}
+
+LandTile::Inputs LandTile::inputs() const
+{
+    Inputs inputs;
+    inputs.position = m_position;
+    inputs.tileSize = m_tileSize;
+    inputs.resolution = m_resolution;
+    // Snap to the nearest level, in the same units as maxError
+    inputs.maxError = m_maxError > 0
+            ? std::exp2(std::round(std::log2(m_maxError) * s_maxErrorLevelsPerOctave) / s_maxErrorLevelsPerOctave)
+            : 0;
+    inputs.heightSource = source();
+    return inputs;
+}
+
+bool LandTile::isUpToDate() const
+{
+    return m_hasData && !m_updatePending && m_loadingKey.isEmpty();
+}
+
+TileDiskCache *LandTile::diskCache() const
+{
+    return m_diskCache;
+}
+
+/**
+ * When a disk cache is set, the generated heights and mesh are stored in it, and
+ * loaded from it rather than generated again the next time the tile is shown.
+ */
+void LandTile::setDiskCache(TileDiskCache *diskCache)
+{
+    if (m_diskCache == diskCache)
+        return;
+
+    m_diskCache = diskCache;
+    emit diskCacheChanged();
 }
 
-float LandTile::getHeight(const QVector2D &pos)
+/**
+ * The key of the tile in the disk cache, which holds the position of the tile,
+ * and everything else that its content depends on.
+ */
+QByteArray LandTile::diskCacheKey(const Inputs &inputs) const
 {
-    const qreal posX = (m_position.x() + pos.x());
-    const qreal posY = (m_position.z() + pos.y());
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream << QByteArrayLiteral("LandTile") << s_diskCacheVersion << inputs.heightSource->settingsHash()
+           << inputs.tileSize << inputs.resolution << inputs.maxError << inputs.position;
+    return key;
+}
 
-    const qreal height0 = 200;
-    const qreal height1 = 10;
-    const qreal height2 = 1;
+/**
+ * Take the heights and the mesh from an \a entry that was read from the disk cache.
+ * Returns false if it doesn't hold what the current inputs need.
+ */
+bool LandTile::loadFromDiskCache(const QByteArray &entry)
+{
+    QDataStream stream(entry);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    QByteArray vertexData;
+    stream >> m_heights >> vertexData;
+    if (stream.status() != QDataStream::Ok
+            || m_heights.count() != (m_gridResolutionX + 1) * (m_gridResolutionZ + 1)
+            || vertexData.size() > m_vertexCapacity) {
+        return false;
+    }
 
-    const qreal scale0 = 0.001;
-    const qreal scale1 = 0.02;
-    const qreal scale2 = 0.1;
+    // Copy into the pooled slab, which has room for it without allocating
+    m_vertexData.append(vertexData);
+    return true;
+}
 
-    const qreal oct0 = m_perlin.noise(posX * scale0, posY * scale0, 0.1) * height0;
-    const qreal oct1 = m_perlin.noise(posX * scale1, posY * scale1, 0.1) * height1;
-    const qreal oct2 = m_perlin.noise(posX * scale2, posY * scale2, 0.1) * height2;
+void LandTile::storeInDiskCache(const QByteArray &key)
+{
+    QByteArray entry;
+    QDataStream stream(&entry, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_6_0);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+    stream << m_heights << m_vertexData;
+    m_diskCache->store(key, entry);
+}
 
-    return oct0 + oct1 + oct2;
+HeightSource *LandTile::source() const
+{
+    return m_heightSource ? m_heightSource.data() : HeightSource::defaultSource();
+}
+
+float LandTile::gridHeight(int x, int z) const
+{
+    return m_heights[z * (m_gridResolutionX + 1) + x];
 }
 
 void LandTile::updateData()
 {
+    m_updatePending = false;
     if (!isComponentComplete())
         return;
 
+    // The properties might have changed back to what the mesh was built from
+    const Inputs current = inputs();
+    if (m_hasData && current == m_builtInputs) {
+        // Don't replace the mesh with an entry that was asked for in between
+        m_loadingKey.clear();
+        // The height source might have been changed and then changed back, which unregistered us
+        current.heightSource->addTile(this);
+        return;
+    }
+
+    if (!m_diskCache) {
+        buildData(current, QByteArray(), QByteArray());
+        return;
+    }
+
+    // Reading an entry takes a while, so it's done on the reader thread of the cache,
+    // like the writes. We keep showing the old mesh until we know if it's there.
+    const QByteArray cacheKey = diskCacheKey(current);
+    if (cacheKey == m_loadingKey)
+        return;
+
+    m_loadingKey = cacheKey;
+    m_diskCache->load(cacheKey, this, [this, current, cacheKey](const QByteArray &entry) {
+        // Only use the entry that was asked for last
+        if (cacheKey != m_loadingKey)
+            return;
+
+        m_loadingKey.clear();
+        if (inputs() == current)
+            buildData(current, cacheKey, entry);
+        else
+            scheduleUpdate();
+    });
+}
+
+/**
+ * Build the mesh for \a inputs, from \a cacheEntry if it was found in the disk cache,
+ * or else by generating it and storing it under \a cacheKey.
+ */
+void LandTile::buildData(const Inputs &inputs, const QByteArray &cacheKey, const QByteArray &cacheEntry)
+{
+    TILE_TRACE_SCOPE("LandTile::buildData", "position", m_position);
+    QElapsedTimer timer;
+    timer.start();
+
+    HeightSource *heightSource = source();
+    m_gridResolutionX = int(m_resolution.x());
+    m_gridResolutionZ = int(m_resolution.z());
+    if (inputs.maxError > 0) {
+        const int resolution = qNextPowerOfTwo(quint32(qMax(1, qMax(m_gridResolutionX, m_gridResolutionZ)) - 1));
+        m_gridResolutionX = resolution;
+        m_gridResolutionZ = resolution;
+    }
+
+    // Generate straight into a pooled slab. Both kinds of mesh need at most two triangles
+    // per cell, so all tiles of the same resolution can share slabs of the same capacity.
+    VertexBufferPool *pool = VertexBufferPool::instance();
+    QByteArray previousVertexData = m_vertexData;
+    const int previousCapacity = m_vertexCapacity;
+    m_vertexCapacity = m_gridResolutionX * m_gridResolutionZ * 6 * stride();
+    m_vertexData = pool->acquire(m_vertexCapacity);
+
+    if (cacheEntry.isEmpty() || !loadFromDiskCache(cacheEntry)) {
+        const float distX = m_tileSize.x() / m_gridResolutionX;
+        const float distZ = m_tileSize.z() / m_gridResolutionZ;
+
+        // Sample the height source once per grid point, rather
+        // than once for every vertex that uses that grid point.
+        m_heights.resize((m_gridResolutionX + 1) * (m_gridResolutionZ + 1));
+        for (int z = 0; z <= m_gridResolutionZ; ++z) {
+            for (int x = 0; x <= m_gridResolutionX; ++x) {
+                const float posX = m_position.x() + x * distX;
+                const float posZ = m_position.z() + z * distZ;
+                m_heights[z * (m_gridResolutionX + 1) + x] = heightSource->sampleHeight(posX, posZ);
+            }
+        }
+
+        if (inputs.maxError > 0)
+            buildAdaptiveMesh(inputs);
+        else
+            buildGridMesh();
+
+        if (m_diskCache && !cacheKey.isEmpty())
+            storeInDiskCache(cacheKey);
+    }
+
+    m_heightNodes.clear();
+    HeightNode root;
+    root.fromX = 0;
+    root.fromZ = 0;
+    root.toX = m_gridResolutionX;
+    root.toZ = m_gridResolutionZ;
+    m_heightNodes.append(root);
+    buildHeightTree(0);
+
+    // Let the view know the real height range of the tile, so that it can be culled
+    const HeightNode &bounds = m_heightNodes.first();
+    setBounds(QVector3D(0, bounds.minHeight, 0), QVector3D(m_tileSize.x(), bounds.maxHeight, m_tileSize.z()));
+
+    setVertexData(m_vertexData);
+    update();
+    pool->release(previousVertexData, previousCapacity);
+    m_builtInputs = inputs;
+    m_hasData = true;
+    heightSource->addTile(this);
+    heightSource->addGenerationTime(timer.nsecsElapsed());
+    emit boundsChanged();
+}
+
+void LandTile::buildGridMesh()
+{
+    const float distX = m_tileSize.x() / m_gridResolutionX;
+    const float distZ = m_tileSize.z() / m_gridResolutionZ;
+
+    const int vertexCountPerSquare = 6; // two triangles
+    const int vertexCount = m_gridResolutionX * m_gridResolutionZ * vertexCountPerSquare;
+    m_vertexData.resize(vertexCount * stride());
     float *p = reinterpret_cast<float *>(m_vertexData.data());
-    const float distX = m_tileSize.x() / m_resolution.x();
-    const float distZ = m_tileSize.z() / m_resolution.z();
 
     // Front face = counter-clockwise
-    for (int x = 0; x < m_resolution.x(); ++x) {
-        for (int z = 0; z < m_resolution.z(); ++z) {
+    for (int x = 0; x < m_gridResolutionX; ++x) {
+        for (int z = 0; z < m_gridResolutionZ; ++z) {
             // Draw two triangles that form a square
-            QVector2D c0((x + 1) * distX, (z + 1) * distZ);
-            QVector2D c1((x + 1) * distX, z * distZ);
-            QVector2D c2(x * distX, (z + 1) * distX);
-            QVector2D c3(x * distX, z * distZ);
-
-            QVector2D uvOffset = QVector2D(m_position.x(),  m_position.z());
-            QVector2D uv0 = c0 + uvOffset;
-            QVector2D uv1 = c1 + uvOffset;
-            QVector2D uv2 = c2 + uvOffset;
-            QVector2D uv3 = c3 + uvOffset;
-
-            COORD(c0);
-            UV(uv0);
-            COORD(c1);
-            UV(uv1);
-            COORD(c2);
-            UV(uv2);
-
-            COORD(c2);
-            UV(uv2);
-            COORD(c1);
-            UV(uv1);
-            COORD(c3);
-            UV(uv3);
+            COORD(x + 1, z + 1);
+            UV(x + 1, z + 1);
+            COORD(x + 1, z);
+            UV(x + 1, z);
+            COORD(x, z + 1);
+            UV(x, z + 1);
+
+            COORD(x, z + 1);
+            UV(x, z + 1);
+            COORD(x + 1, z);
+            UV(x + 1, z);
+            COORD(x, z);
+            UV(x, z);
         }
     }
+}
 
-    setVertexData(m_vertexData);
-    update();
+/**
+ * Build a right-triangulated irregular network (RTIN) over the height grid (see AdaptiveMesh).
+ * To pick the same vertices along the edges as the neighbouring tiles, it also needs the
+ * heights of a narrow band of the terrain around the tile, which are only sampled for this.
+ */
+void LandTile::buildAdaptiveMesh(const Inputs &inputs)
+{
+    const int n = m_gridResolutionX;
+    const float distX = m_tileSize.x() / m_gridResolutionX;
+    const float distZ = m_tileSize.z() / m_gridResolutionZ;
+
+    AdaptiveMesh mesh(n, inputs.maxError, s_maxEdgeSegment);
+    const int band = mesh.bandWidth();
+    const int size = n + 1 + 2 * band;
+    QVector<float> heights(size * size, 0);
+    for (int z = -band; z <= n + band; ++z) {
+        for (int x = -band; x <= n + band; ++x) {
+            const bool insideX = x >= 0 && x <= n;
+            const bool insideZ = z >= 0 && z <= n;
+            float &height = heights[(z + band) * size + x + band];
+            if (insideX && insideZ)
+                height = gridHeight(x, z);
+            else if (insideX || insideZ)
+                height = inputs.heightSource->sampleHeight(m_position.x() + x * distX, m_position.z() + z * distZ);
+        }
+    }
+
+    const std::vector<int> corners = mesh.build([&](int x, int z) {
+        return heights[(z + band) * size + x + band];
+    });
+
+    m_vertexData.resize(int(corners.size()) / 2 * stride());
+    float *p = reinterpret_cast<float *>(m_vertexData.data());
+    for (size_t i = 0; i < corners.size(); i += 2) {
+        COORD(corners[i], corners[i + 1]);
+        UV(corners[i], corners[i + 1]);
+    }
+}
+
+void LandTile::buildHeightTree(int nodeIndex)
+{
+    const HeightNode node = m_heightNodes[nodeIndex];
+    const int sizeX = node.toX - node.fromX;
+    const int sizeZ = node.toZ - node.fromZ;
+
+    if (sizeX == 1 && sizeZ == 1) {
+        const float h0 = gridHeight(node.fromX, node.fromZ);
+        const float h1 = gridHeight(node.toX, node.fromZ);
+        const float h2 = gridHeight(node.fromX, node.toZ);
+        const float h3 = gridHeight(node.toX, node.toZ);
+        m_heightNodes[nodeIndex].minHeight = qMin(qMin(h0, h1), qMin(h2, h3));
+        m_heightNodes[nodeIndex].maxHeight = qMax(qMax(h0, h1), qMax(h2, h3));
+        return;
+    }
+
+    // Split the node in two along each axis that is more than one cell wide
+    const int midX = node.fromX + sizeX / 2;
+    const int midZ = node.fromZ + sizeZ / 2;
+    const int firstChild = m_heightNodes.count();
+    for (int i = 0; i < 4; ++i) {
+        const bool upperX = i & 1;
+        const bool upperZ = i & 2;
+        if ((upperX && sizeX == 1) || (upperZ && sizeZ == 1))
+            continue;
+        HeightNode child;
+        child.fromX = upperX ? midX : node.fromX;
+        child.toX = upperX || sizeX == 1 ? node.toX : midX;
+        child.fromZ = upperZ ? midZ : node.fromZ;
+        child.toZ = upperZ || sizeZ == 1 ? node.toZ : midZ;
+        m_heightNodes.append(child);
+    }
+
+    const int childCount = m_heightNodes.count() - firstChild;
+    float minHeight = std::numeric_limits<float>::max();
+    float maxHeight = std::numeric_limits<float>::lowest();
+    for (int child = firstChild; child < firstChild + childCount; ++child) {
+        buildHeightTree(child);
+        minHeight = qMin(minHeight, m_heightNodes[child].minHeight);
+        maxHeight = qMax(maxHeight, m_heightNodes[child].maxHeight);
+    }
+
+    HeightNode &n = m_heightNodes[nodeIndex];
+    n.firstChild = firstChild;
+    n.childCount = childCount;
+    n.minHeight = minHeight;
+    n.maxHeight = maxHeight;
+}
+
+/**
+ * Returns the height of the terrain at the given position (in the same space as position),
+ * interpolated from the generated height grid. Positions outside the tile are forwarded
+ * to the height source.
+ */
+float LandTile::heightAt(float x, float z) const
+{
+    // Answer from the mesh that is shown, even if the properties have changed since
+    const QVector3D position = m_builtInputs.position;
+    const QVector3D tileSize = m_builtInputs.tileSize;
+    const float gridX = (x - position.x()) / tileSize.x() * m_gridResolutionX;
+    const float gridZ = (z - position.z()) / tileSize.z() * m_gridResolutionZ;
+
+    if (m_heights.isEmpty() || gridX < 0 || gridZ < 0 || gridX > m_gridResolutionX || gridZ > m_gridResolutionZ)
+        return source()->sampleHeight(x, z);
+
+    const int cellX = qMin(int(gridX), m_gridResolutionX - 1);
+    const int cellZ = qMin(int(gridZ), m_gridResolutionZ - 1);
+    const float u = gridX - cellX;
+    const float v = gridZ - cellZ;
+
+    const float h0 = gridHeight(cellX, cellZ) * (1 - u) + gridHeight(cellX + 1, cellZ) * u;
+    const float h1 = gridHeight(cellX, cellZ + 1) * (1 - u) + gridHeight(cellX + 1, cellZ + 1) * u;
+    return h0 * (1 - v) + h1 * v;
+}
+
+/**
+ * Returns the distance along \a direction from \a origin to where the ray hits the tile,
+ * or -1 if it doesn't hit it within \a maxDistance.
+ */
+float LandTile::raycast(const QVector3D &origin, const QVector3D &direction, float maxDistance) const
+{
+    float distance = 0;
+    const QVector3D dir = direction.normalized();
+    if (dir.isNull() || !intersectRay(origin, dir, 0, maxDistance, &distance))
+        return -1;
+    return distance;
+}
+
+static bool intersectBox(const QVector3D &origin, const QVector3D &direction,
+                         const QVector3D &minimum, const QVector3D &maximum, float *from, float *to)
+{
+    for (int axis = 0; axis < 3; ++axis) {
+        if (qFuzzyIsNull(direction[axis])) {
+            if (origin[axis] < minimum[axis] || origin[axis] > maximum[axis])
+                return false;
+            continue;
+        }
+        float enter = (minimum[axis] - origin[axis]) / direction[axis];
+        float exit = (maximum[axis] - origin[axis]) / direction[axis];
+        if (enter > exit)
+            std::swap(enter, exit);
+        *from = qMax(*from, enter);
+        *to = qMin(*to, exit);
+        if (*from > *to)
+            return false;
+    }
+    return true;
+}
+
+static bool intersectTriangle(const QVector3D &origin, const QVector3D &direction,
+                              const QVector3D &v0, const QVector3D &v1, const QVector3D &v2, float *distance)
+{
+    // Möller-Trumbore
+    const QVector3D edge1 = v1 - v0;
+    const QVector3D edge2 = v2 - v0;
+    const QVector3D pvec = QVector3D::crossProduct(direction, edge2);
+    const float det = QVector3D::dotProduct(edge1, pvec);
+    if (qFuzzyIsNull(det))
+        return false;
+
+    const float invDet = 1 / det;
+    const QVector3D tvec = origin - v0;
+    const float u = QVector3D::dotProduct(tvec, pvec) * invDet;
+    if (u < 0 || u > 1)
+        return false;
+
+    const QVector3D qvec = QVector3D::crossProduct(tvec, edge1);
+    const float v = QVector3D::dotProduct(direction, qvec) * invDet;
+    if (v < 0 || u + v > 1)
+        return false;
+
+    *distance = QVector3D::dotProduct(edge2, qvec) * invDet;
+    return true;
+}
+
+bool LandTile::intersectRay(const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance) const
+{
+    if (m_heightNodes.isEmpty())
+        return false;
+
+    const QVector3D localOrigin = origin - QVector3D(m_builtInputs.position.x(), 0, m_builtInputs.position.z());
+    return intersectNode(0, localOrigin, direction, from, to, distance);
+}
+
+bool LandTile::intersectNode(int nodeIndex, const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance) const
+{
+    const HeightNode &node = m_heightNodes[nodeIndex];
+    const float distX = m_builtInputs.tileSize.x() / m_gridResolutionX;
+    const float distZ = m_builtInputs.tileSize.z() / m_gridResolutionZ;
+
+    const QVector3D minimum(node.fromX * distX, node.minHeight, node.fromZ * distZ);
+    const QVector3D maximum(node.toX * distX, node.maxHeight, node.toZ * distZ);
+    if (!intersectBox(origin, direction, minimum, maximum, &from, &to))
+        return false;
+
+    if (node.childCount == 0) {
+        // Test the two triangles that the cell is drawn with (see updateData)
+        const int x = node.fromX;
+        const int z = node.fromZ;
+        const QVector3D c0((x + 1) * distX, gridHeight(x + 1, z + 1), (z + 1) * distZ);
+        const QVector3D c1((x + 1) * distX, gridHeight(x + 1, z), z * distZ);
+        const QVector3D c2(x * distX, gridHeight(x, z + 1), (z + 1) * distZ);
+        const QVector3D c3(x * distX, gridHeight(x, z), z * distZ);
+
+        // Allow for some rounding errors, since the triangles touch the sides of the box
+        const float epsilon = 0.001f;
+        float nearest = std::numeric_limits<float>::max();
+        float hit = 0;
+        if (intersectTriangle(origin, direction, c0, c1, c2, &hit) && hit >= from - epsilon && hit <= to + epsilon)
+            nearest = hit;
+        if (intersectTriangle(origin, direction, c2, c1, c3, &hit) && hit >= from - epsilon && hit <= to + epsilon)
+            nearest = qMin(nearest, hit);
+        if (nearest == std::numeric_limits<float>::max())
+            return false;
+
+        *distance = nearest;
+        return true;
+    }
+
+    // Visit the children in the order the ray enters them, so that the first hit is the nearest
+    QVarLengthArray<QPair<float, int>, 4> children;
+    for (int child = node.firstChild; child < node.firstChild + node.childCount; ++child) {
+        const HeightNode &c = m_heightNodes[child];
+        float enter = from;
+        float exit = to;
+        const QVector3D childMinimum(c.fromX * distX, c.minHeight, c.fromZ * distZ);
+        const QVector3D childMaximum(c.toX * distX, c.maxHeight, c.toZ * distZ);
+        if (intersectBox(origin, direction, childMinimum, childMaximum, &enter, &exit))
+            children.append(qMakePair(enter, child));
+    }
+    std::sort(children.begin(), children.end());
+
+    for (const auto &child : qAsConst(children)) {
+        if (intersectNode(child.second, origin, direction, from, to, distance))
+            return true;
+    }
+
+    return false;
 }
@@ -4,7 +4,8 @@
 #include <QtGui/QtGui>
 #include <QQuick3DGeometry>
 
-#include "perlinnoise.h"
+#include "heightsource.h"
+#include "tilediskcache.h"
 
 class LandTile : public QQuick3DGeometry
 {
@@ -14,10 +15,15 @@ class LandTile : public QQuick3DGeometry
     Q_PROPERTY(QVector3D tileSize READ tileSize WRITE setTileSize NOTIFY tileSizeChanged)
     Q_PROPERTY(QVector3D resolution READ resolution WRITE setResolution NOTIFY resolutionChanged)
     Q_PROPERTY(QVector3D position READ position WRITE setPosition NOTIFY positionChanged)
-    Q_PROPERTY(QVector3D sampleScale READ sampleScale WRITE setSampleScale NOTIFY sampleScaleChanged)
+    Q_PROPERTY(float maxError READ maxError WRITE setMaxError NOTIFY maxErrorChanged)
+    Q_PROPERTY(QVector3D boundsMin READ boundsMin NOTIFY boundsChanged)
+    Q_PROPERTY(QVector3D boundsMax READ boundsMax NOTIFY boundsChanged)
+    Q_PROPERTY(HeightSource *heightSource READ heightSource WRITE setHeightSource NOTIFY heightSourceChanged)
+    Q_PROPERTY(TileDiskCache *diskCache READ diskCache WRITE setDiskCache NOTIFY diskCacheChanged)
 
 public:
     LandTile();
+    ~LandTile() override;
 
     QVector3D tileSize() const;
     void setTileSize(QVector3D tileSize);
@@ -28,31 +34,102 @@ public:
     QVector3D position() const;
     void setPosition(QVector3D position);
 
-    QVector3D sampleScale() const;
-    void setSampleScale(QVector3D sampleScale);
+    float maxError() const;
+    void setMaxError(float maxError);
+
+    HeightSource *heightSource() const;
+    void setHeightSource(HeightSource *heightSource);
+
+    TileDiskCache *diskCache() const;
+    void setDiskCache(TileDiskCache *diskCache);
+
+    Q_INVOKABLE float heightAt(float x, float z) const;
+    Q_INVOKABLE float raycast(const QVector3D &origin, const QVector3D &direction, float maxDistance = 10000) const;
+    bool intersectRay(const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance) const;
+    bool isUpToDate() const;
 
 signals:
     void tileSizeChanged();
     void resolutionChanged();
     void positionChanged();
-    void sampleScaleChanged();
+    void maxErrorChanged();
+    void boundsChanged();
+    void heightSourceChanged();
+    void diskCacheChanged();
 
 protected:
     void componentComplete() override;
 
 private:
-    float getHeight(const QVector2D &pos);
+    // The properties that the mesh is built from
+    struct Inputs
+    {
+        QVector3D position;
+        QVector3D tileSize;
+        QVector3D resolution;
+        float maxError = 0;
+        HeightSource *heightSource = nullptr;
+
+        bool operator==(const Inputs &other) const
+        {
+            return position == other.position && tileSize == other.tileSize && resolution == other.resolution
+                    && maxError == other.maxError && heightSource == other.heightSource;
+        }
+    };
+
+    struct HeightNode
+    {
+        int fromX;
+        int fromZ;
+        int toX;
+        int toZ;
+        float minHeight;
+        float maxHeight;
+        int firstChild = -1;
+        int childCount = 0;
+    };
+
+    HeightSource *source() const;
+    Inputs inputs() const;
+    void scheduleUpdate();
+    float gridHeight(int x, int z) const;
+    void buildHeightTree(int nodeIndex);
+    bool intersectNode(int nodeIndex, const QVector3D &origin, const QVector3D &direction, float from, float to, float *distance) const;
+
+    QByteArray diskCacheKey(const Inputs &inputs) const;
+    bool loadFromDiskCache(const QByteArray &entry);
+    void storeInDiskCache(const QByteArray &key);
+
     void recreate();
     void updateData();
+    void buildData(const Inputs &inputs, const QByteArray &cacheKey, const QByteArray &cacheEntry);
+    void buildGridMesh();
+    void buildAdaptiveMesh(const Inputs &inputs);
 
 private:
     QVector3D m_position;
     QVector3D m_tileSize = QVector3D(100, 100, 100);
     QVector3D m_resolution = QVector3D(10, 10, 10);
-    QVector3D m_sampleScale = QVector3D(0.1, 0.1, 0.1);
+    float m_maxError = 0;
 
     QByteArray m_vertexData;
-    PerlinNoise m_perlin;
+    int m_vertexCapacity = 0;
+    QPointer<HeightSource> m_heightSource;
+    QPointer<TileDiskCache> m_diskCache;
+
+    Inputs m_builtInputs;
+    bool m_hasData = false;
+    bool m_updatePending = false;
+
+    // The key of the disk cache entry that is being read for the current inputs, if any
+    QByteArray m_loadingKey;
+
+    // The generated heights, and a tree of min/max heights on top of
+    // them that lets us quickly skip parts of the tile when raycasting
+    int m_gridResolutionX = 0;
+    int m_gridResolutionZ = 0;
+    QVector<float> m_heights;
+    QVector<HeightNode> m_heightNodes;
 };
 
 #endif
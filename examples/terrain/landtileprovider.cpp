@@ -0,0 +1,34 @@
+#include "landtileprovider.h"
+#include "landtile.h"
+
+LandTileProvider::LandTileProvider(QObject *parent)
+    : QObject(parent)
+{
+}
+
+LandTile *LandTileProvider::landTile(const Tile &tile)
+{
+    // The delegate is expected to be a Model with a LandTile as geometry
+    const QVariant geometry = tile.delegate->property("geometry");
+    return qobject_cast<LandTile *>(geometry.value<QQuick3DGeometry *>());
+}
+
+void LandTileProvider::tilesAssigned(const QVector<Tile> &tiles)
+{
+    for (const Tile &tile : tiles) {
+        if (LandTile *land = landTile(tile))
+            land->setPosition(tile.delegate->property("position").value<QVector3D>());
+    }
+}
+
+bool LandTileProvider::tileBounds(const Tile &tile, QVector3D *minimum, QVector3D *maximum) const
+{
+    // Until the tile has been regenerated, the bounds are those of the tile it showed before
+    LandTile *land = landTile(tile);
+    if (!land || !land->isUpToDate())
+        return false;
+
+    *minimum = land->boundsMin();
+    *maximum = land->boundsMax();
+    return true;
+}
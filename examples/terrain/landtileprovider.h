@@ -0,0 +1,27 @@
+#ifndef LANDTILEPROVIDER_H
+#define LANDTILEPROVIDER_H
+
+#include <QtCore/QtCore>
+#include <QtQml/qqml.h>
+
+#include "tilecontentprovider.h"
+
+class LandTile;
+
+class LandTileProvider : public QObject, public TileContentProvider
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_INTERFACES(TileContentProvider)
+
+public:
+    explicit LandTileProvider(QObject *parent = nullptr);
+
+    void tilesAssigned(const QVector<Tile> &tiles) override;
+    bool tileBounds(const Tile &tile, QVector3D *minimum, QVector3D *maximum) const override;
+
+private:
+    static LandTile *landTile(const Tile &tile);
+};
+
+#endif // LANDTILEPROVIDER_H
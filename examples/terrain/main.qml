@@ -40,6 +40,10 @@ Window {
             value: 1
             onValueChanged: print("scale:", value)
         }
+        CheckBox {
+            id: gpuDisplacementCheckBox
+            text: "GPU displacement"
+        }
     }
 
     View3D {
@@ -71,6 +75,33 @@ Window {
         }
     }
 
+    HeightSource {
+        id: heightSource
+    }
+
+    // Keep the generated tiles on disk, so that they don't need to be generated
+    // again when they come back into view, or when the example is started again.
+    TileDiskCache {
+        id: tileCache
+        maximumSize: 128 * 1024 * 1024
+    }
+
+    // Trade detail for speed (and back) to keep up with the display. The settings
+    // below that depend on the quality are bound to it. With vsync the frame time
+    // never drops below the refresh interval, so it can't tell us when there's time
+    // to spare. Measure the time spent generating terrain in each frame instead,
+    // and keep it to a quarter of the refresh interval, which leaves the rest for
+    // the scene and the renderer.
+    TileQualityController {
+        id: qualityController
+        targetTime: 0.25 * 1000 / Screen.refreshRate
+    }
+
+    FrameAnimation {
+        running: true
+        onTriggered: qualityController.cost = heightSource.takeGenerationTime()
+    }
+
     Node {
         id: scene
 
@@ -78,27 +109,152 @@ Window {
             id: tileView
             center: personCamera.position
             tileSize: Qt.vector3d(300, 1, 300)
-            tileCount: Qt.vector3d(20, 1, 20)
+            tileCount: Qt.vector3d(10, 1, 10)
+            // Put most of the tiles in front of the camera, and don't roll
+            // back and forth while it moves around near the edge of a tile
+            lookAhead: 2
+            rollMargin: 0.2
+            updateBudget: Math.round(4 + 16 * qualityController.quality)
 
-            delegate: Model {
-                id: delegate
+            // Let the provider position the LandTiles directly from
+            // C++, rather than through a binding to delegate.position
+            contentProvider: gpuDisplacementCheckBox.checked ? null : landTileProvider
+            delegate: gpuDisplacementCheckBox.checked ? displacedTile : landTile
 
-                materials: [
-                    DefaultMaterial {
-                        diffuseMap: Texture {
-                            source: "textures/grass.jpg"
-                            scaleU: 0.01
-                            scaleV: 0.01
-                            mappingMode: Texture.UV
+            LandTileProvider {
+                id: landTileProvider
+            }
+
+            Component {
+                id: landTile
+
+                Model {
+                    id: delegate
+
+                    materials: [
+                        DefaultMaterial {
+                            diffuseMap: Texture {
+                                source: "textures/grass.jpg"
+                                scaleU: 0.01
+                                scaleV: 0.01
+                                mappingMode: Texture.UV
+                            }
                         }
+                    ]
+
+                    geometry: LandTile {
+                        heightSource: heightSource
+                        diskCache: tileCache
+                        resolution: Qt.vector3d(32, 32, 32)
+                        // The resolution of the content scales through maxError,
+                        // which decides how much of the grid the mesh uses
+                        maxError: 3 - 2.5 * qualityController.quality
+                        tileSize: delegate.parent.tileSize
                     }
-                ]
+                }
+            }
+
+            // All tiles share one flat grid, which is displaced by a small height texture
+            // per tile. Assigning a tile then only uploads (resolution + 3)^2 heights.
+            Component {
+                id: displacedTile
 
-                geometry: LandTile {
-                    resolution: Qt.vector3d(30, 30, 30)
-                    sampleScale: Qt.vector3d(0.001, 0.001, 0.001)
-                    tileSize: delegate.parent.tileSize
-                    position: delegate.position
+                Model {
+                    id: delegate
+                    geometry: gridMesh
+
+                    TileView.boundsMin: heightMap.boundsMin
+                    TileView.boundsMax: heightMap.boundsMax
+
+                    materials: [
+                        CustomMaterial {
+                            vertexShader: "shaders/heightmap.vert"
+                            fragmentShader: "shaders/heightmap.frag"
+
+                            property vector3d tileSize: tileView.tileSize
+                            property real groundScale: 0.01
+                            property TextureInput heightMap: TextureInput {
+                                texture: Texture {
+                                    minFilter: Texture.Nearest
+                                    magFilter: Texture.Nearest
+                                    mipFilter: Texture.None
+                                    textureData: HeightMap {
+                                        id: heightMap
+                                        heightSource: heightSource
+                                        resolution: gridMesh.resolution
+                                        tileSize: tileView.tileSize
+                                        position: delegate.position
+                                    }
+                                }
+                            }
+                            property TextureInput groundMap: TextureInput {
+                                texture: Texture {
+                                    source: "textures/grass.jpg"
+                                }
+                            }
+                        }
+                    ]
+                }
+            }
+
+            GridMesh {
+                id: gridMesh
+                heightSource: heightSource
+                resolution: Qt.vector3d(32, 32, 32)
+                tileSize: tileView.tileSize
+            }
+
+            // Trees only in the tiles closest to the camera (which is a bit behind the
+            // middle of the window, because of lookAhead). They're planted on the
+            // ground that the LandTile of the same tile has generated.
+            layers: TileLayer {
+                name: "trees"
+                tileCount: Qt.vector3d(6, 1, 6)
+
+                delegate: Node {
+                    id: trees
+
+                    property LandTile land: null
+
+                    // Without a LandTile (with GPU displacement), ask the height source instead
+                    function heightAt(x, z) {
+                        return land ? land.heightAt(x, z) : heightSource.heightAt(x, z)
+                    }
+
+                    function plant() {
+                        for (let i = 0; i < treeRepeater.count; ++i) {
+                            const tree = treeRepeater.objectAt(i)
+                            // Spread the trees out in the same way each time the tile is shown
+                            const x = (Math.sin(TileView.tile.x * 12.9898 + TileView.tile.z * 78.233 + i * 4.1414) * 0.5 + 0.5) * tileView.tileSize.x
+                            const z = (Math.sin(TileView.tile.x * 39.3468 + TileView.tile.z * 11.135 + i * 7.2331) * 0.5 + 0.5) * tileView.tileSize.z
+                            tree.position = Qt.vector3d(x, heightAt(position.x + x, position.z + z), z)
+                        }
+                    }
+
+                    TileView.onTileChanged: {
+                        const ground = TileView.layerDelegate("")
+                        land = ground && ground.geometry instanceof LandTile ? ground.geometry : null
+                        plant()
+                    }
+
+                    Connections {
+                        target: trees.land
+                        function onBoundsChanged() { trees.plant() }
+                    }
+
+                    Repeater3D {
+                        id: treeRepeater
+                        model: 12
+                        delegate: Model {
+                            source: "#Cone"
+                            scale: Qt.vector3d(0.3, 0.8, 0.3)
+                            materials: [
+                                DefaultMaterial {
+                                    diffuseColor: "#2f5a2a"
+                                }
+                            ]
+                        }
+                    }
                 }
             }
 
@@ -109,9 +265,40 @@ Window {
             Component.onCompleted: direction = personCamera.forward
         }
 
+        // A coarse ring of terrain around the tiles, to push the horizon further out
+        Model {
+            materials: [
+                DefaultMaterial {
+                    diffuseMap: Texture {
+                        source: "textures/grass.jpg"
+                        scaleU: 0.01
+                        scaleV: 0.01
+                        mappingMode: Texture.UV
+                    }
+                }
+            ]
+
+            geometry: FarField {
+                heightSource: heightSource
+                innerMin: tileView.windowMin
+                innerMax: tileView.windowMax
+                size: {
+                    const s = 5000 + 3000 * qualityController.quality
+                    return Qt.vector3d(s, 0, s)
+                }
+                cellSize: 400 - 200 * qualityController.quality
+            }
+        }
+
         PerspectiveCamera {
             id: personCamera
             position: Qt.vector3d(0, 130, 0)
+            onPositionChanged: {
+                // Don't let the camera go below ground
+                const ground = heightSource.heightAt(x, z) + 2
+                if (y < ground)
+                    y = ground
+            }
             Model {
                 source: "#Cone"
                 scale: Qt.vector3d(2.0, 2.0, 2.0)
@@ -0,0 +1,8 @@
+// Same look as the LandTiles, which use the world position as UV
+
+void MAIN()
+{
+    BASE_COLOR = texture(groundMap, VAR_WORLD_POSITION.xz * groundScale);
+    ROUGHNESS = 1.0;
+    METALNESS = 0.0;
+}
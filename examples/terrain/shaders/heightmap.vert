@@ -0,0 +1,19 @@
+// Displace the flat GridMesh by the HeightMap of the tile
+
+void MAIN()
+{
+    // The height map has a border of one sample around the grid
+    ivec2 size = textureSize(heightMap, 0);
+    vec2 cells = vec2(size - ivec2(3, 3));
+    ivec2 texel = ivec2(round(UV0 * cells)) + ivec2(1, 1);
+
+    float height = texelFetch(heightMap, texel, 0).r;
+    float left = texelFetch(heightMap, texel - ivec2(1, 0), 0).r;
+    float right = texelFetch(heightMap, texel + ivec2(1, 0), 0).r;
+    float back = texelFetch(heightMap, texel - ivec2(0, 1), 0).r;
+    float front = texelFetch(heightMap, texel + ivec2(0, 1), 0).r;
+
+    vec2 dist = tileSize.xz / cells;
+    VERTEX.y = height;
+    NORMAL = normalize(vec3((left - right) / (2.0 * dist.x), 1.0, (back - front) / (2.0 * dist.y)));
+}
@@ -5,14 +5,31 @@ CONFIG += qmltypes
 QML_IMPORT_NAME = LandTile
 QML_IMPORT_MAJOR_VERSION = 1
 
+INCLUDEPATH += ../../src
+
 SOURCES += \
     main.cpp \
+    farfield.cpp \
+    gridmesh.cpp \
+    heightmap.cpp \
+    heightsource.cpp \
     landtile.cpp \
+    landtileprovider.cpp \
     perlinnoise.cpp \
+    tilediskcache.cpp \
+    vertexbufferpool.cpp \
 
 HEADERS += \
+    adaptivemesh.h \
+    farfield.h \
+    gridmesh.h \
+    heightmap.h \
+    heightsource.h \
     landtile.h \
-    perlinnoise.h
+    landtileprovider.h \
+    perlinnoise.h \
+    tilediskcache.h \
+    vertexbufferpool.h
 
 RESOURCES += \
     resources.qrc \
@@ -0,0 +1,296 @@
+#include "tilediskcache.h"
+#include "tiletrace.h"
+
+static const char s_fileSuffix[] = ".tile";
+
+TileDiskCache::TileDiskCache(QObject *parent)
+    : QObject(parent)
+{
+    // One writer is enough, and keeps the writes to the same entry in order. One
+    // reader keeps up with loading the tiles of a frame, since it does little else.
+    m_reader.setMaxThreadCount(1);
+    m_writer.setMaxThreadCount(1);
+
+    // The entries are looked up by file name, so keep the directory in the same
+    // form as the paths of the files that scanDirectory() finds in it.
+    m_directory = QDir(QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/tiles")).absolutePath();
+}
+
+TileDiskCache::~TileDiskCache()
+{
+    m_reader.waitForDone();
+    m_writer.waitForDone();
+}
+
+void TileDiskCache::classBegin()
+{
+}
+
+/**
+ * Only scan the directory once the properties are set, so that we
+ * don't scan the default directory when another one is set from QML.
+ */
+void TileDiskCache::componentComplete()
+{
+    m_componentComplete = true;
+    const QString directory = m_directory;
+    m_writer.start([this, directory] {
+        scanDirectory(directory);
+    });
+}
+
+QString TileDiskCache::directory() const
+{
+    return m_directory;
+}
+
+/**
+ * The directory where the entries are stored. It's created if it doesn't exist. The
+ * default is a "tiles" directory in the cache location of the application. A relative
+ * path is resolved against the current directory.
+ */
+void TileDiskCache::setDirectory(const QString &path)
+{
+    const QString directory = QDir(path).absolutePath();
+    if (m_directory == directory)
+        return;
+
+    // Let the reads and writes of the old directory finish first
+    m_reader.waitForDone();
+    m_writer.waitForDone();
+
+    m_directory = directory;
+    if (m_componentComplete) {
+        {
+            QMutexLocker locker(&m_mutex);
+            m_entries.clear();
+            m_totalSize = 0;
+            m_scanned = false;
+        }
+        m_writer.start([this, directory] {
+            scanDirectory(directory);
+        });
+    }
+    emit directoryChanged();
+}
+
+qint64 TileDiskCache::maximumSize() const
+{
+    return m_maximumSize;
+}
+
+void TileDiskCache::setMaximumSize(qint64 maximumSize)
+{
+    if (m_maximumSize == maximumSize)
+        return;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_maximumSize = maximumSize;
+    }
+    m_writer.start([this] {
+        QMutexLocker locker(&m_mutex);
+        evict();
+    });
+    emit maximumSizeChanged();
+}
+
+QString TileDiskCache::fileName(const QByteArray &key) const
+{
+    const QByteArray hash = QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+    return m_directory + QLatin1Char('/') + QString::fromLatin1(hash) + QLatin1String(s_fileSuffix);
+}
+
+/**
+ * Pick up the entries that earlier sessions left behind. Their modification time
+ * tells when they were last used (see read()). Runs on the writer thread, before
+ * anything is written to \a directory.
+ */
+void TileDiskCache::scanDirectory(const QString &directory)
+{
+    TILE_TRACE_SCOPE("TileDiskCache::scanDirectory");
+
+    QDir().mkpath(directory);
+    const QString filter = QLatin1Char('*') + QLatin1String(s_fileSuffix);
+    const QFileInfoList files = QDir(directory).entryInfoList({ filter }, QDir::Files);
+
+    QMutexLocker locker(&m_mutex);
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    for (const QFileInfo &file : files) {
+        // The same path as fileName() gives for the key of the entry
+        const QString name = directory + QLatin1Char('/') + file.fileName();
+        Entry entry;
+        entry.size = file.size();
+        entry.lastUsed = m_usedFiles.contains(name) ? now : file.lastModified().toMSecsSinceEpoch();
+        m_entries.insert(name, entry);
+        m_totalSize += entry.size;
+    }
+    m_scanned = true;
+    evict();
+}
+
+/**
+ * Look up the entry for \a key, and call \a loaded with its content, or with an empty
+ * array if there is no such entry, or it can't be read. The file is read on the reader
+ * thread, and \a loaded is called later on from the event loop of the thread that the
+ * cache belongs to (which \a context should belong to as well), unless \a context is
+ * destroyed first.
+ */
+void TileDiskCache::load(const QByteArray &key, QObject *context, const std::function<void(const QByteArray &data)> &loaded)
+{
+    const QPointer<QObject> receiver(context);
+    const auto deliver = [this, receiver, loaded](const QByteArray &data) {
+        // Check the receiver on our own thread, which it belongs to as well
+        QMetaObject::invokeMethod(this, [receiver, loaded, data] {
+            if (receiver)
+                loaded(data);
+        }, Qt::QueuedConnection);
+    };
+
+    const QString name = fileName(key);
+    {
+        QMutexLocker locker(&m_mutex);
+        const auto pending = m_pendingWrites.constFind(name);
+        if (pending != m_pendingWrites.constEnd()) {
+            deliver(pending.value());
+            return;
+        }
+
+        // Until the directory has been scanned, just try to open the file
+        const auto entry = m_entries.find(name);
+        if (entry == m_entries.end() && m_scanned) {
+            deliver(QByteArray());
+            return;
+        }
+        if (entry != m_entries.end())
+            entry->lastUsed = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    m_reader.start([this, name, key, deliver] {
+        deliver(read(name, key));
+    });
+}
+
+/**
+ * Returns the content stored in \a fileName for \a key, or an empty array if it
+ * can't be read. Runs on the reader thread.
+ */
+QByteArray TileDiskCache::read(const QString &fileName, const QByteArray &key)
+{
+    TILE_TRACE_SCOPE("TileDiskCache::read");
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    // The file name is only a hash of the key, so check that it's really the same key
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    QByteArray storedKey;
+    QByteArray data;
+    stream >> storedKey >> data;
+    if (stream.status() != QDataStream::Ok || storedKey != key)
+        return QByteArray();
+
+    // Let the next session know that the entry is still in use. Touching the file
+    // is left to the writer thread, which does all the files used since in one go.
+    QMutexLocker locker(&m_mutex);
+    m_usedFiles.insert(fileName);
+    if (!m_touchPending) {
+        m_touchPending = true;
+        m_writer.start([this] {
+            touchFiles();
+        });
+    }
+    return data;
+}
+
+/**
+ * Store \a data as the entry for \a key. The file is written on a worker thread,
+ * but the entry can be loaded again right away.
+ */
+void TileDiskCache::store(const QByteArray &key, const QByteArray &data)
+{
+    const QString name = fileName(key);
+    {
+        QMutexLocker locker(&m_mutex);
+        m_pendingWrites.insert(name, data);
+    }
+
+    m_writer.start([this, name, key, data] {
+        write(name, key, data);
+    });
+}
+
+void TileDiskCache::touchFiles()
+{
+    TILE_TRACE_SCOPE("TileDiskCache::touchFiles");
+
+    QSet<QString> files;
+    {
+        QMutexLocker locker(&m_mutex);
+        files.swap(m_usedFiles);
+        m_touchPending = false;
+    }
+
+    // Windows only lets us change the time of a file that is open for writing. A file that
+    // can't be touched is only removed sooner by a later session, since this one already
+    // knows when it was used. ExistingOnly keeps us from recreating evicted files.
+    const QDateTime now = QDateTime::currentDateTime();
+    for (const QString &name : qAsConst(files)) {
+        QFile file(name);
+        if (file.open(QIODevice::ReadWrite | QIODevice::ExistingOnly))
+            file.setFileTime(now, QFileDevice::FileModificationTime);
+    }
+}
+
+void TileDiskCache::write(const QString &fileName, const QByteArray &key, const QByteArray &data)
+{
+    TILE_TRACE_SCOPE("TileDiskCache::write");
+
+    // Write to a temporary file first, so that a session that is killed while
+    // writing doesn't leave a half written entry behind for the next one.
+    QSaveFile file(fileName);
+    bool written = false;
+    if (file.open(QIODevice::WriteOnly)) {
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << key << data;
+        written = stream.status() == QDataStream::Ok && file.commit();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_pendingWrites.remove(fileName);
+    if (!written)
+        return;
+
+    const qint64 size = QFileInfo(fileName).size();
+    Entry &entry = m_entries[fileName];
+    m_totalSize += size - entry.size;
+    entry.size = size;
+    entry.lastUsed = QDateTime::currentMSecsSinceEpoch();
+    evict();
+}
+
+/**
+ * Remove the least recently used entries until the cache fits within maximumSize
+ * again. Expects m_mutex to be locked.
+ */
+void TileDiskCache::evict()
+{
+    if (m_totalSize <= m_maximumSize)
+        return;
+
+    QVector<QPair<qint64, QString>> entries;
+    entries.reserve(m_entries.count());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it)
+        entries.append(qMakePair(it.value().lastUsed, it.key()));
+    std::sort(entries.begin(), entries.end());
+
+    for (const auto &entry : qAsConst(entries)) {
+        if (m_totalSize <= m_maximumSize)
+            break;
+        QFile::remove(entry.second);
+        m_totalSize -= m_entries.take(entry.second).size;
+    }
+}
@@ -0,0 +1,83 @@
+#ifndef TILEDISKCACHE_H
+#define TILEDISKCACHE_H
+
+#include <QtCore/QtCore>
+#include <QtQml/qqml.h>
+#include <QtQml/qqmlparserstatus.h>
+
+/**
+ * TileDiskCache keeps the content that was generated for tiles in files on disk, so that
+ * it can be loaded rather than generated again the next time the tile is shown, also
+ * in a later session. The cache doesn't know what the content is: each entry is just a
+ * blob stored under a key, which should contain everything that the content depends on.
+ * Changing any of that gives a new key, so entries never need to be invalidated.
+ *
+ * Entries are read and written on worker threads, and the least recently used ones are
+ * removed once the files take up more than maximumSize bytes. The directory is scanned
+ * for the entries of earlier sessions on the writer thread, once the directory is known.
+ */
+class TileDiskCache : public QObject, public QQmlParserStatus
+{
+    Q_OBJECT
+    QML_ELEMENT
+    Q_INTERFACES(QQmlParserStatus)
+
+    Q_PROPERTY(QString directory READ directory WRITE setDirectory NOTIFY directoryChanged)
+    Q_PROPERTY(qint64 maximumSize READ maximumSize WRITE setMaximumSize NOTIFY maximumSizeChanged)
+
+public:
+    explicit TileDiskCache(QObject *parent = nullptr);
+    ~TileDiskCache() override;
+
+    QString directory() const;
+    void setDirectory(const QString &path);
+
+    qint64 maximumSize() const;
+    void setMaximumSize(qint64 maximumSize);
+
+    void load(const QByteArray &key, QObject *context, const std::function<void(const QByteArray &data)> &loaded);
+    void store(const QByteArray &key, const QByteArray &data);
+
+signals:
+    void directoryChanged();
+    void maximumSizeChanged();
+
+protected:
+    void classBegin() override;
+    void componentComplete() override;
+
+private:
+    struct Entry
+    {
+        qint64 size = 0;
+        qint64 lastUsed = 0;
+    };
+
+    QString fileName(const QByteArray &key) const;
+    void scanDirectory(const QString &directory);
+    QByteArray read(const QString &fileName, const QByteArray &key);
+    void touchFiles();
+    void write(const QString &fileName, const QByteArray &key, const QByteArray &data);
+    void evict();
+
+private:
+    QString m_directory;
+    qint64 m_maximumSize = 256 * 1024 * 1024;
+    bool m_componentComplete = false;
+
+    // Everything below is shared with the worker threads, and guarded by m_mutex
+    QMutex m_mutex;
+    QHash<QString, Entry> m_entries;
+    QHash<QString, QByteArray> m_pendingWrites;
+    qint64 m_totalSize = 0;
+    bool m_scanned = false;
+
+    // Files that were loaded, and should get a new modification time (see touchFiles)
+    QSet<QString> m_usedFiles;
+    bool m_touchPending = false;
+
+    QThreadPool m_reader;
+    QThreadPool m_writer;
+};
+
+#endif // TILEDISKCACHE_H
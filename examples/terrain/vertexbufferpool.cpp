@@ -0,0 +1,47 @@
+#include "vertexbufferpool.h"
+
+// The number of free slabs we keep around per capacity. Slabs that are
+// released when we already have this many are freed instead.
+static const int s_maxFreeSlabs = 64;
+
+Q_GLOBAL_STATIC(VertexBufferPool, s_vertexBufferPool)
+
+VertexBufferPool *VertexBufferPool::instance()
+{
+    return s_vertexBufferPool();
+}
+
+/**
+ * Returns an empty buffer that can be resized up to \a capacity bytes without
+ * allocating, and written to without making a copy.
+ */
+QByteArray VertexBufferPool::acquire(int capacity)
+{
+    QVector<QByteArray> &slabs = m_freeSlabs[capacity];
+    for (int i = slabs.count() - 1; i >= 0; --i) {
+        if (slabs[i].isDetached()) {
+            QByteArray slab = slabs.takeAt(i);
+            slab.resize(0);
+            return slab;
+        }
+    }
+
+    QByteArray slab;
+    slab.reserve(capacity);
+    return slab;
+}
+
+/**
+ * Give \a buffer, which was acquired with the given \a capacity, back to the pool.
+ * The caller's reference to it is cleared.
+ */
+void VertexBufferPool::release(QByteArray &buffer, int capacity)
+{
+    if (buffer.isNull())
+        return;
+
+    QVector<QByteArray> &slabs = m_freeSlabs[capacity];
+    if (slabs.count() < s_maxFreeSlabs)
+        slabs.append(buffer);
+    buffer = QByteArray();
+}
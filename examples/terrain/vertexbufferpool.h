@@ -0,0 +1,29 @@
+#ifndef VERTEXBUFFERPOOL_H
+#define VERTEXBUFFERPOOL_H
+
+#include <QtCore/QtCore>
+
+/**
+ * VertexBufferPool hands out vertex buffers (slabs) of a fixed capacity, and takes
+ * them back when they are no longer needed, so that tiles of the same resolution
+ * can reuse each other's buffers rather than allocating new ones every time they are
+ * regenerated.
+ *
+ * A buffer that is given to QQuick3DGeometry::setVertexData() is shared with the
+ * geometry (and later the renderer), and writing to it while it's shared would make
+ * a copy. So a slab that is released is only handed out again once nobody else holds
+ * a reference to it anymore.
+ */
+class VertexBufferPool
+{
+public:
+    static VertexBufferPool *instance();
+
+    QByteArray acquire(int capacity);
+    void release(QByteArray &buffer, int capacity);
+
+private:
+    QHash<int, QVector<QByteArray>> m_freeSlabs;
+};
+
+#endif // VERTEXBUFFERPOOL_H
@@ -17,10 +17,17 @@ DYNAMIC_QMLDIR = \
 "TileView 1.0 TileView.qml"
 
 SOURCES += \
+    tilechunktree.cpp \
+    tilequalitycontroller.cpp \
     tileview.cpp \
     tileviewplugin.cpp
 
 HEADERS += \
+    tilechunktree.h \
+    tilecontentprovider.h \
+    tilequalitycontroller.h \
+    tilegrid.h \
+    tiletrace.h \
     tileview.h
 
 CONFIG += qt plugin
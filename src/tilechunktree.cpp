@@ -0,0 +1,223 @@
+#include "tilechunktree.h"
+
+void TileChunkTree::reset(const TileGrid<3>::Coord &count)
+{
+    m_count = count;
+    m_chunks.clear();
+    m_leafOrder.clear();
+
+    const int cellCount = count[0] * count[1] * count[2];
+    m_leafChunks.fill(-1, cellCount);
+    if (cellCount == 0)
+        return;
+
+    m_chunks.append(Chunk());
+    build(0, { 0, 0, 0 }, count);
+}
+
+void TileChunkTree::build(int chunkIndex, const TileGrid<3>::Coord &from, const TileGrid<3>::Coord &to)
+{
+    m_chunks[chunkIndex].firstLeaf = m_leafOrder.count();
+
+    // Split the chunk in two along every axis that is more than one cell wide. This
+    // gives an octree for a 3D matrix, a quadtree for a 2D matrix, and so on.
+    int splitCount = 1;
+    TileGrid<3>::Coord mid;
+    for (int axis = 0; axis < 3; ++axis) {
+        mid[axis] = from[axis] + (to[axis] - from[axis]) / 2;
+        if (to[axis] - from[axis] > 1)
+            splitCount *= 2;
+    }
+
+    if (splitCount == 1) {
+        const int index = from[0] + (from[1] + from[2] * m_count[1]) * m_count[0];
+        m_leafChunks[index] = chunkIndex;
+        m_leafOrder.append(index);
+        m_chunks[chunkIndex].leafCount = 1;
+        return;
+    }
+
+    // Add all the children first, so that they end up next to each other
+    const int firstChild = m_chunks.count();
+    m_chunks[chunkIndex].firstChild = firstChild;
+    m_chunks[chunkIndex].childCount = splitCount;
+    for (int i = 0; i < splitCount; ++i) {
+        Chunk child;
+        child.parent = chunkIndex;
+        m_chunks.append(child);
+    }
+
+    int child = firstChild;
+    for (int octant = 0; octant < 8; ++octant) {
+        TileGrid<3>::Coord childFrom = from;
+        TileGrid<3>::Coord childTo = to;
+        bool skip = false;
+        for (int axis = 0; axis < 3; ++axis) {
+            const bool upper = octant & (1 << axis);
+            if (to[axis] - from[axis] <= 1) {
+                skip |= upper;
+                continue;
+            }
+            if (upper)
+                childFrom[axis] = mid[axis];
+            else
+                childTo[axis] = mid[axis];
+        }
+        if (!skip)
+            build(child++, childFrom, childTo);
+    }
+
+    m_chunks[chunkIndex].leafCount = m_leafOrder.count() - m_chunks[chunkIndex].firstLeaf;
+}
+
+void TileChunkTree::setBounds(int index, const QVector3D &minimum, const QVector3D &maximum)
+{
+    int chunkIndex = m_leafChunks[index];
+    Chunk &leaf = m_chunks[chunkIndex];
+    if (leaf.minimum == minimum && leaf.maximum == maximum)
+        return;
+
+    leaf.minimum = minimum;
+    leaf.maximum = maximum;
+
+    // Mark the chunks on the path up to the root as needing a refit. If
+    // we hit a chunk that is already dirty, the rest of the path is as well.
+    chunkIndex = leaf.parent;
+    while (chunkIndex != -1 && !m_chunks[chunkIndex].dirty) {
+        m_chunks[chunkIndex].dirty = true;
+        chunkIndex = m_chunks[chunkIndex].parent;
+    }
+}
+
+void TileChunkTree::refit(int chunkIndex)
+{
+    Chunk &chunk = m_chunks[chunkIndex];
+    if (!chunk.dirty)
+        return;
+
+    const int lastChild = chunk.firstChild + chunk.childCount;
+    for (int child = chunk.firstChild; child < lastChild; ++child)
+        refit(child);
+
+    QVector3D minimum = m_chunks[chunk.firstChild].minimum;
+    QVector3D maximum = m_chunks[chunk.firstChild].maximum;
+    for (int child = chunk.firstChild + 1; child < lastChild; ++child) {
+        const Chunk &c = m_chunks[child];
+        minimum = QVector3D(qMin(minimum.x(), c.minimum.x()), qMin(minimum.y(), c.minimum.y()), qMin(minimum.z(), c.minimum.z()));
+        maximum = QVector3D(qMax(maximum.x(), c.maximum.x()), qMax(maximum.y(), c.maximum.y()), qMax(maximum.z(), c.maximum.z()));
+    }
+
+    chunk.minimum = minimum;
+    chunk.maximum = maximum;
+    chunk.dirty = false;
+}
+
+TileChunkTree::Side TileChunkTree::side(const Chunk &chunk, const QVector3D &planePoint, const QVector3D &planeNormal) const
+{
+    // Project the box onto the plane normal, and check on which
+    // side of the plane the nearest and furthest corner ends up.
+    const QVector3D center = (chunk.minimum + chunk.maximum) / 2;
+    const QVector3D extent = (chunk.maximum - chunk.minimum) / 2;
+    const float distance = QVector3D::dotProduct(center - planePoint, planeNormal);
+    const float radius = extent.x() * qAbs(planeNormal.x())
+            + extent.y() * qAbs(planeNormal.y())
+            + extent.z() * qAbs(planeNormal.z());
+
+    if (distance + radius <= 0)
+        return Side::Behind;
+    if (distance - radius > 0)
+        return Side::InFront;
+    return Side::Intersecting;
+}
+
+/**
+ * Set all the leaves of the chunk at \a chunkIndex to \a isVisible. If the last cull
+ * already did the same, there's nothing to do. Otherwise only the leaves that actually
+ * change are written, and added to \a changed.
+ */
+void TileChunkTree::setLeavesVisible(int chunkIndex, bool isVisible, QVector<bool> *visible, QVector<int> *changed)
+{
+    const Leaves leaves = isVisible ? Leaves::Visible : Leaves::Hidden;
+    if (m_chunks[chunkIndex].leaves == leaves)
+        return;
+
+    const Chunk &chunk = m_chunks[chunkIndex];
+    const int lastLeaf = chunk.firstLeaf + chunk.leafCount;
+    for (int leaf = chunk.firstLeaf; leaf < lastLeaf; ++leaf) {
+        const int index = m_leafOrder[leaf];
+        if ((*visible)[index] == isVisible)
+            continue;
+        (*visible)[index] = isVisible;
+        if (changed)
+            changed->append(index);
+    }
+
+    setSubtreeLeaves(chunkIndex, leaves);
+}
+
+void TileChunkTree::setSubtreeLeaves(int chunkIndex, Leaves leaves)
+{
+    Chunk &chunk = m_chunks[chunkIndex];
+    chunk.leaves = leaves;
+
+    const int lastChild = chunk.firstChild + chunk.childCount;
+    for (int child = chunk.firstChild; child < lastChild; ++child)
+        setSubtreeLeaves(child, leaves);
+}
+
+void TileChunkTree::cull(int chunkIndex, const QVector3D &planePoint, const QVector3D &planeNormal,
+                         QVector<bool> *visible, QVector<int> *changed)
+{
+    Chunk &chunk = m_chunks[chunkIndex];
+
+    switch (side(chunk, planePoint, planeNormal)) {
+    case Side::Behind:
+        setLeavesVisible(chunkIndex, false, visible, changed);
+        return;
+    case Side::InFront:
+        setLeavesVisible(chunkIndex, true, visible, changed);
+        return;
+    case Side::Intersecting:
+        if (chunk.childCount == 0) {
+            setLeavesVisible(chunkIndex, true, visible, changed);
+            return;
+        }
+        break;
+    }
+
+    // The children might end up different from each other, so we can no longer
+    // tell what the leaves are set to from this chunk alone.
+    chunk.leaves = Leaves::Unknown;
+
+    const int firstChild = chunk.firstChild;
+    const int lastChild = firstChild + chunk.childCount;
+    for (int child = firstChild; child < lastChild; ++child)
+        cull(child, planePoint, planeNormal, visible, changed);
+}
+
+/**
+ * Update \a visible (indexed by the tile matrix index) to tell which tiles have a
+ * bounding box that is at least partially in front of the plane that goes through
+ * \a planePoint with the given \a planeNormal. If the normal is null, all tiles are
+ * considered visible.
+ *
+ * \a visible is expected to hold the result of the previous call. Chunks that end up
+ * on the same side of the plane as last time are skipped, so the cost depends on the
+ * number of chunks that intersect the plane or change side, rather than on the number
+ * of tiles. The tiles that changed visibility are added to \a changed.
+ */
+void TileChunkTree::updateVisibility(const QVector3D &planePoint, const QVector3D &planeNormal,
+                                     QVector<bool> *visible, QVector<int> *changed)
+{
+    visible->resize(m_leafChunks.count());
+    if (m_chunks.isEmpty())
+        return;
+
+    if (planeNormal.isNull()) {
+        setLeavesVisible(0, true, visible, changed);
+        return;
+    }
+
+    refit(0);
+    cull(0, planePoint, planeNormal, visible, changed);
+}
@@ -0,0 +1,73 @@
+#ifndef TILECHUNKTREE_H
+#define TILECHUNKTREE_H
+
+#include <QtCore/QtCore>
+#include <QtGui/QVector3D>
+
+#include "tilegrid.h"
+
+/**
+ * TileChunkTree groups the cells of a tile matrix into a quadtree or octree
+ * of chunks (depending on how many axes have more than one tile), where each
+ * chunk knows the bounding box of all the tiles inside it. This lets us accept
+ * or reject whole chunks of tiles with a single test when culling.
+ *
+ * The tree is built over matrix coordinates rather than tile coordinates. That
+ * way, rolling the tile matrix only touches the bounding boxes of the chunks
+ * that contain cells that got a new tile. A chunk that straddles the seam of the
+ * ring buffer will get a box that covers both sides of the window, which is
+ * conservative, but still correct.
+ */
+class TileChunkTree
+{
+public:
+    void reset(const TileGrid<3>::Coord &count);
+
+    void setBounds(int index, const QVector3D &minimum, const QVector3D &maximum);
+
+    void updateVisibility(const QVector3D &planePoint, const QVector3D &planeNormal,
+                          QVector<bool> *visible, QVector<int> *changed = nullptr);
+
+private:
+    enum class Side {
+        Behind,
+        Intersecting,
+        InFront
+    };
+
+    // What the last cull set the leaves of a chunk to, if it set all of them the same
+    enum class Leaves {
+        Unknown,
+        Hidden,
+        Visible
+    };
+
+    struct Chunk
+    {
+        QVector3D minimum;
+        QVector3D maximum;
+        int parent = -1;
+        int firstChild = -1;
+        int childCount = 0;
+        int firstLeaf = 0;
+        int leafCount = 0;
+        bool dirty = false;
+        Leaves leaves = Leaves::Unknown;
+    };
+
+    void build(int chunkIndex, const TileGrid<3>::Coord &from, const TileGrid<3>::Coord &to);
+    void refit(int chunkIndex);
+    Side side(const Chunk &chunk, const QVector3D &planePoint, const QVector3D &planeNormal) const;
+    void cull(int chunkIndex, const QVector3D &planePoint, const QVector3D &planeNormal,
+              QVector<bool> *visible, QVector<int> *changed);
+    void setLeavesVisible(int chunkIndex, bool isVisible, QVector<bool> *visible, QVector<int> *changed);
+    void setSubtreeLeaves(int chunkIndex, Leaves leaves);
+
+private:
+    TileGrid<3>::Coord m_count = {};
+    QVector<Chunk> m_chunks;
+    QVector<int> m_leafChunks;
+    QVector<int> m_leafOrder;
+};
+
+#endif // TILECHUNKTREE_H
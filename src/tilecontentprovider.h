@@ -0,0 +1,59 @@
+#ifndef TILECONTENTPROVIDER_H
+#define TILECONTENTPROVIDER_H
+
+#include <QtCore/QtCore>
+#include <QtGui/QVector3D>
+
+struct Tile
+{
+    QVector3D position;
+    QVector3D tileCoord;
+    QVector3D matrixCoord;
+    QObject *delegate = nullptr;
+    bool visible = false;
+};
+
+/**
+ * A content provider can be set on a TileView to create the content of the
+ * tiles from C++. When a provider is set, TileView will no longer update the
+ * TileView.tile attached property of the delegates (and hence not emit
+ * tileChanged). Instead it will, once per update, tell the provider about all
+ * the tiles that were affected by it in one call per kind of change.
+ *
+ * This header doesn't depend on the TileView plugin itself, so it can be
+ * included and implemented by applications that only use TileView from QML.
+ * The implementing class should be a QObject that lists TileContentProvider
+ * in Q_INTERFACES, so that it can be assigned to TileView.contentProvider.
+ */
+class TileContentProvider
+{
+public:
+    virtual ~TileContentProvider() = default;
+
+    // The delegates of \a tiles have been positioned, and should now
+    // show the content of the tile they have been assigned.
+    virtual void tilesAssigned(const QVector<Tile> &tiles) = 0;
+
+    // The delegates of \a tiles are about to be assigned another tile (or
+    // be destroyed), so the content they show for \a tiles can be released.
+    virtual void tilesEvicted(const QVector<Tile> &tiles) { Q_UNUSED(tiles); }
+
+    // The delegates of \a tiles have been shown or hidden (see Tile::visible).
+    virtual void tilesVisibilityChanged(const QVector<Tile> &tiles) { Q_UNUSED(tiles); }
+
+    // Return the bounding box of the content for \a tile relative to its delegate, if known.
+    // TileView asks again in each update until it is, and then keeps using that box for
+    // as long as the tile stays assigned.
+    virtual bool tileBounds(const Tile &tile, QVector3D *minimum, QVector3D *maximum) const
+    {
+        Q_UNUSED(tile);
+        Q_UNUSED(minimum);
+        Q_UNUSED(maximum);
+        return false;
+    }
+};
+
+#define TileContentProvider_iid "org.qt-project.Qt.QtQuick3D.TileView.TileContentProvider"
+Q_DECLARE_INTERFACE(TileContentProvider, TileContentProvider_iid)
+
+#endif // TILECONTENTPROVIDER_H
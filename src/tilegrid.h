@@ -0,0 +1,273 @@
+#ifndef TILEGRID_H
+#define TILEGRID_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/**
+ * TileGrid is the plain C++ core of TileView. It keeps track of which tile
+ * coordinate each cell in a fixed size matrix of Dims dimensions currently
+ * maps to, and rolls the matrix as a ring buffer when the window moves.
+ *
+ * Rather than moving all the cells in the matrix when a new row appears on
+ * one side, we move a "pointer" instead. This pointer is the corner cell: the
+ * cell in the matrix that maps to the tile with the highest coordinate along
+ * every axis. When the window moves, the rows that fall out on one side are
+ * reused for the rows that appear on the opposite side.
+ *
+ * The class has no dependencies on Qt, so it can be used (and tested) outside
+ * of Qt Quick, e.g for interest management on a server.
+ */
+template <int Dims>
+class TileGrid
+{
+    static_assert(Dims >= 1 && Dims <= 3, "TileGrid supports 1, 2 or 3 dimensions");
+
+public:
+    using Coord = std::array<int32_t, Dims>;
+
+    struct Cell
+    {
+        Coord tileCoord;
+        Coord matrixCoord;
+        int32_t index;
+    };
+
+    TileGrid()
+    {
+        m_count.fill(0);
+        m_cornerTile.fill(0);
+        m_cornerMatrix.fill(0);
+    }
+
+    /**
+     * Resize the matrix to \a count cells along each axis, and let it cover
+     * the tiles starting at \a originTile (the tile with the lowest coordinate).
+     */
+    void reset(const Coord &count, const Coord &originTile = Coord{})
+    {
+        m_count = count;
+        for (int axis = 0; axis < Dims; ++axis) {
+            m_cornerMatrix[axis] = m_count[axis] - 1;
+            m_cornerTile[axis] = originTile[axis] + m_count[axis] - 1;
+        }
+    }
+
+    const Coord &count() const { return m_count; }
+    const Coord &cornerTile() const { return m_cornerTile; }
+    const Coord &cornerMatrix() const { return m_cornerMatrix; }
+
+    int32_t cellCount() const
+    {
+        int32_t cells = 1;
+        for (int axis = 0; axis < Dims; ++axis)
+            cells *= m_count[axis];
+        return cells;
+    }
+
+    Coord originTile() const
+    {
+        Coord origin;
+        for (int axis = 0; axis < Dims; ++axis)
+            origin[axis] = m_cornerTile[axis] - m_count[axis] + 1;
+        return origin;
+    }
+
+    int32_t indexOf(const Coord &matrixCoord) const
+    {
+        if constexpr (Dims == 1)
+            return matrixCoord[0];
+        else if constexpr (Dims == 2)
+            return matrixCoord[0] + matrixCoord[1] * m_count[0];
+        else
+            return matrixCoord[0] + (matrixCoord[1] + matrixCoord[2] * m_count[1]) * m_count[0];
+    }
+
+    bool contains(const Coord &tileCoord) const
+    {
+        for (int axis = 0; axis < Dims; ++axis) {
+            if (tileCoord[axis] > m_cornerTile[axis] || tileCoord[axis] <= m_cornerTile[axis] - m_count[axis])
+                return false;
+        }
+        return true;
+    }
+
+    Coord tileCoordOf(const Coord &matrixCoord) const
+    {
+        // Which tile a cell maps to depends on which tile the corner maps to. So we need
+        // to calculate the offset between the corner and the given cell. This is most easily
+        // done by normalizing the corner so that we don't need to take wrapping into account.
+        Coord tileCoord;
+        for (int axis = 0; axis < Dims; ++axis) {
+            const int32_t last = m_count[axis] - 1;
+            const int32_t norm = wrapped(matrixCoord[axis], last - m_cornerMatrix[axis], m_count[axis]);
+            tileCoord[axis] = m_cornerTile[axis] + norm - last;
+        }
+        return tileCoord;
+    }
+
+    Coord matrixCoordOf(const Coord &tileCoord) const
+    {
+        Coord matrixCoord;
+        for (int axis = 0; axis < Dims; ++axis)
+            matrixCoord[axis] = wrapped(m_cornerMatrix[axis], tileCoord[axis] - m_cornerTile[axis], m_count[axis]);
+        return matrixCoord;
+    }
+
+    Cell cellAt(const Coord &matrixCoord) const
+    {
+        return Cell{tileCoordOf(matrixCoord), matrixCoord, indexOf(matrixCoord)};
+    }
+
+    /**
+     * Call \a func with every cell in the matrix, in index order.
+     */
+    template <typename Func>
+    void forEachCell(Func func) const
+    {
+        Coord m;
+        if constexpr (Dims == 1) {
+            for (m[0] = 0; m[0] < m_count[0]; ++m[0])
+                func(cellAt(m));
+        } else if constexpr (Dims == 2) {
+            for (m[1] = 0; m[1] < m_count[1]; ++m[1]) {
+                for (m[0] = 0; m[0] < m_count[0]; ++m[0])
+                    func(cellAt(m));
+            }
+        } else {
+            for (m[2] = 0; m[2] < m_count[2]; ++m[2]) {
+                for (m[1] = 0; m[1] < m_count[1]; ++m[1]) {
+                    for (m[0] = 0; m[0] < m_count[0]; ++m[0])
+                        func(cellAt(m));
+                }
+            }
+        }
+    }
+
+    /**
+     * Move the window \a delta tiles along each axis. If \a changed is given, it will
+     * be filled with the cells that now map to a different tile than before. Each cell
+     * is only reported once, even if it rolled along several axes.
+     */
+    void shift(const Coord &delta, std::vector<Cell> *changed = nullptr)
+    {
+        if (changed)
+            changed->clear();
+        if (cellCount() == 0)
+            return;
+
+        bool moved = false;
+        for (int axis = 0; axis < Dims; ++axis) {
+            if (delta[axis] == 0)
+                continue;
+            moved = true;
+            m_cornerTile[axis] += delta[axis];
+            m_cornerMatrix[axis] = wrapped(m_cornerMatrix[axis], delta[axis], m_count[axis]);
+        }
+
+        if (!moved || !changed)
+            return;
+
+        // For each axis, split the matrix rows into the ones that rolled over to
+        // the other side of the window, and the ones that kept their tile.
+        std::array<std::vector<int32_t>, Dims> rolled;
+        std::array<std::vector<int32_t>, Dims> kept;
+        std::array<std::vector<int32_t>, Dims> all;
+        for (int axis = 0; axis < Dims; ++axis) {
+            const int32_t count = m_count[axis];
+            const int32_t rolledCount = std::min(std::abs(delta[axis]), count);
+            // New tiles enter at the high end of the window when moving along the positive
+            // axis, and at the low end (which is the cell right after the corner) otherwise.
+            const int32_t first = delta[axis] > 0 ? m_cornerMatrix[axis] - rolledCount + 1 : m_cornerMatrix[axis] + 1;
+            std::vector<bool> isRolled(size_t(count), false);
+            for (int32_t i = 0; i < rolledCount; ++i)
+                isRolled[size_t(wrapped(first, i, count))] = true;
+            for (int32_t m = 0; m < count; ++m) {
+                all[axis].push_back(m);
+                (isRolled[size_t(m)] ? rolled[axis] : kept[axis]).push_back(m);
+            }
+        }
+
+        // A cell changed if it rolled along at least one axis. To report each cell only
+        // once, we attribute it to the first axis it rolled along.
+        for (int axis = 0; axis < Dims; ++axis) {
+            if (rolled[axis].empty())
+                continue;
+            std::array<const std::vector<int32_t> *, Dims> rows;
+            for (int other = 0; other < Dims; ++other) {
+                if (other < axis)
+                    rows[other] = &kept[other];
+                else if (other == axis)
+                    rows[other] = &rolled[other];
+                else
+                    rows[other] = &all[other];
+            }
+            forEachRowCombination(rows, [&](const Coord &m) { changed->push_back(cellAt(m)); });
+        }
+    }
+
+    /**
+     * Move the window so that it starts at \a originTile.
+     */
+    void moveTo(const Coord &originTile, std::vector<Cell> *changed = nullptr)
+    {
+        const Coord origin = this->originTile();
+        Coord delta;
+        for (int axis = 0; axis < Dims; ++axis)
+            delta[axis] = originTile[axis] - origin[axis];
+        shift(delta, changed);
+    }
+
+    /**
+     * Return the new position of \a startCoord in the matrix if you shift it \a shiftCount
+     * cells along an axis with \a count cells. This might mean that it wraps around on the
+     * other side of the matrix.
+     */
+    static int32_t wrapped(int32_t startCoord, int32_t shiftCount, int32_t count)
+    {
+        const int32_t coord = (startCoord + shiftCount) % count;
+        return coord < 0 ? coord + count : coord;
+    }
+
+private:
+    template <typename Func>
+    static void forEachRowCombination(const std::array<const std::vector<int32_t> *, Dims> &rows, Func func)
+    {
+        Coord m;
+        if constexpr (Dims == 1) {
+            for (int32_t x : *rows[0]) {
+                m[0] = x;
+                func(m);
+            }
+        } else if constexpr (Dims == 2) {
+            for (int32_t y : *rows[1]) {
+                m[1] = y;
+                for (int32_t x : *rows[0]) {
+                    m[0] = x;
+                    func(m);
+                }
+            }
+        } else {
+            for (int32_t z : *rows[2]) {
+                m[2] = z;
+                for (int32_t y : *rows[1]) {
+                    m[1] = y;
+                    for (int32_t x : *rows[0]) {
+                        m[0] = x;
+                        func(m);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    Coord m_count;
+    Coord m_cornerTile;
+    Coord m_cornerMatrix;
+};
+
+#endif // TILEGRID_H
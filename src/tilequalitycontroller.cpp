@@ -0,0 +1,226 @@
+#include "tilequalitycontroller.h"
+
+Q_LOGGING_CATEGORY(lcTileQuality, "qt.quick3d.tileview.quality")
+
+static const int s_maxRaiseBackoff = 64;
+
+/**
+ * TileQualityController picks a quality level that keeps a measured cost (typically
+ * the time spent generating tile content) close to targetTime. Assign a new measurement
+ * to cost once per frame. The cost has to be able to drop below targetTime * (1 - hysteresis)
+ * for the level to ever be raised, so the frame time is only useful without vsync, which
+ * holds it at the refresh interval no matter how much time there is to spare. When the running average of the
+ * cost stays above targetTime * (1 + hysteresis), the level is lowered by one step,
+ * and when it stays below targetTime * (1 - hysteresis), it's raised by one step,
+ * but never outside the range from minimumLevel to maximumLevel. After each change,
+ * the controller waits for settleSamples new measurements before it acts again.
+ *
+ * The controller doesn't know what a level means. Instead the application binds the
+ * settings it wants to scale (like TileView.updateBudget, the tile count, or the
+ * resolution of the content) to quality, which goes from 0 to 1. For example
+ * "updateBudget: Math.round(4 + 16 * controller.quality)". Read quality in the binding
+ * itself, so that QML knows to evaluate the binding again when it changes.
+ *
+ * Every adjustment is logged to the qt.quick3d.tileview.quality logging category.
+ */
+TileQualityController::TileQualityController(QObject *parent)
+    : QObject(parent)
+{
+}
+
+qreal TileQualityController::targetTime() const
+{
+    return m_targetTime;
+}
+
+void TileQualityController::setTargetTime(qreal targetTime)
+{
+    if (qFuzzyCompare(m_targetTime, targetTime))
+        return;
+
+    m_targetTime = targetTime;
+    restartSampling();
+    emit targetTimeChanged();
+}
+
+qreal TileQualityController::cost() const
+{
+    return m_cost;
+}
+
+void TileQualityController::setCost(qreal cost)
+{
+    m_cost = cost;
+    m_averageCost = m_sampleCount == 0 ? cost : m_averageCost + (cost - m_averageCost) * m_smoothing;
+    ++m_sampleCount;
+    emit costChanged();
+
+    if (m_sampleCount < m_settleSamples)
+        return;
+
+    if (m_averageCost > m_targetTime * (1 + m_hysteresis)) {
+        if (m_level > lowestLevel()) {
+            if (m_level - 1 == m_raisedFromLevel)
+                m_raiseBackoff = qMin(m_raiseBackoff * 2, s_maxRaiseBackoff);
+            adjustLevel(m_level - 1, "over budget");
+        }
+    } else if (m_averageCost < m_targetTime * (1 - m_hysteresis)) {
+        if (m_level < highestLevel() && m_sampleCount >= m_settleSamples * m_raiseBackoff) {
+            m_raisedFromLevel = m_level;
+            adjustLevel(m_level + 1, "under budget");
+        }
+    } else if (m_sampleCount >= m_settleSamples * s_maxRaiseBackoff) {
+        // We have been within budget for a long while, so the
+        // last time we had to back off is no longer relevant.
+        m_raiseBackoff = 1;
+    }
+}
+
+qreal TileQualityController::averageCost() const
+{
+    return m_averageCost;
+}
+
+int TileQualityController::level() const
+{
+    return m_level;
+}
+
+void TileQualityController::setLevel(int level)
+{
+    level = qBound(lowestLevel(), level, highestLevel());
+    if (m_level == level)
+        return;
+
+    m_level = level;
+    restartSampling();
+    emit levelChanged();
+}
+
+int TileQualityController::levelCount() const
+{
+    return m_levelCount;
+}
+
+void TileQualityController::setLevelCount(int levelCount)
+{
+    levelCount = qMax(1, levelCount);
+    if (m_levelCount == levelCount)
+        return;
+
+    // The quality of the current level changes along with the number of levels
+    m_levelCount = levelCount;
+    m_level = qBound(lowestLevel(), m_level, highestLevel());
+    restartSampling();
+    emit levelCountChanged();
+    emit levelChanged();
+}
+
+int TileQualityController::minimumLevel() const
+{
+    return m_minimumLevel;
+}
+
+void TileQualityController::setMinimumLevel(int minimumLevel)
+{
+    if (m_minimumLevel == minimumLevel)
+        return;
+
+    m_minimumLevel = minimumLevel;
+    emit minimumLevelChanged();
+    setLevel(m_level);
+}
+
+/**
+ * The highest level the controller will pick. The default
+ * value, -1, means the last level (levelCount - 1).
+ */
+int TileQualityController::maximumLevel() const
+{
+    return m_maximumLevel;
+}
+
+void TileQualityController::setMaximumLevel(int maximumLevel)
+{
+    if (m_maximumLevel == maximumLevel)
+        return;
+
+    m_maximumLevel = maximumLevel;
+    emit maximumLevelChanged();
+    setLevel(m_level);
+}
+
+qreal TileQualityController::quality() const
+{
+    return m_levelCount > 1 ? qreal(m_level) / (m_levelCount - 1) : 1;
+}
+
+qreal TileQualityController::hysteresis() const
+{
+    return m_hysteresis;
+}
+
+void TileQualityController::setHysteresis(qreal hysteresis)
+{
+    if (qFuzzyCompare(m_hysteresis, hysteresis))
+        return;
+
+    m_hysteresis = hysteresis;
+    emit hysteresisChanged();
+}
+
+qreal TileQualityController::smoothing() const
+{
+    return m_smoothing;
+}
+
+void TileQualityController::setSmoothing(qreal smoothing)
+{
+    smoothing = qBound(0., smoothing, 1.);
+    if (qFuzzyCompare(m_smoothing, smoothing))
+        return;
+
+    m_smoothing = smoothing;
+    emit smoothingChanged();
+}
+
+int TileQualityController::settleSamples() const
+{
+    return m_settleSamples;
+}
+
+void TileQualityController::setSettleSamples(int settleSamples)
+{
+    if (m_settleSamples == settleSamples)
+        return;
+
+    m_settleSamples = settleSamples;
+    emit settleSamplesChanged();
+}
+
+int TileQualityController::lowestLevel() const
+{
+    return qBound(0, m_minimumLevel, m_levelCount - 1);
+}
+
+int TileQualityController::highestLevel() const
+{
+    const int maximum = m_maximumLevel < 0 ? m_levelCount - 1 : m_maximumLevel;
+    return qBound(lowestLevel(), maximum, m_levelCount - 1);
+}
+
+void TileQualityController::adjustLevel(int level, const char *reason)
+{
+    qCInfo(lcTileQuality).nospace() << "level " << m_level << " -> " << level << " (" << reason
+                                    << ": average cost " << m_averageCost << " ms, target "
+                                    << m_targetTime << " ms)";
+    m_level = level;
+    restartSampling();
+    emit levelChanged();
+}
+
+void TileQualityController::restartSampling()
+{
+    // Measurements taken before the change don't tell us anything about the new setting
+    m_sampleCount = 0;
+}
@@ -0,0 +1,97 @@
+#ifndef TILEQUALITYCONTROLLER_H
+#define TILEQUALITYCONTROLLER_H
+
+#include <QtCore/QtCore>
+#include <QtQml/QtQml>
+
+Q_DECLARE_LOGGING_CATEGORY(lcTileQuality)
+
+class TileQualityController : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(qreal targetTime READ targetTime WRITE setTargetTime NOTIFY targetTimeChanged)
+    Q_PROPERTY(qreal cost READ cost WRITE setCost NOTIFY costChanged)
+    Q_PROPERTY(qreal averageCost READ averageCost NOTIFY costChanged)
+    Q_PROPERTY(int level READ level WRITE setLevel NOTIFY levelChanged)
+    Q_PROPERTY(int levelCount READ levelCount WRITE setLevelCount NOTIFY levelCountChanged)
+    Q_PROPERTY(int minimumLevel READ minimumLevel WRITE setMinimumLevel NOTIFY minimumLevelChanged)
+    Q_PROPERTY(int maximumLevel READ maximumLevel WRITE setMaximumLevel NOTIFY maximumLevelChanged)
+    Q_PROPERTY(qreal quality READ quality NOTIFY levelChanged)
+    Q_PROPERTY(qreal hysteresis READ hysteresis WRITE setHysteresis NOTIFY hysteresisChanged)
+    Q_PROPERTY(qreal smoothing READ smoothing WRITE setSmoothing NOTIFY smoothingChanged)
+    Q_PROPERTY(int settleSamples READ settleSamples WRITE setSettleSamples NOTIFY settleSamplesChanged)
+
+public:
+    explicit TileQualityController(QObject *parent = nullptr);
+
+    qreal targetTime() const;
+    void setTargetTime(qreal targetTime);
+
+    qreal cost() const;
+    void setCost(qreal cost);
+
+    qreal averageCost() const;
+
+    int level() const;
+    void setLevel(int level);
+
+    int levelCount() const;
+    void setLevelCount(int levelCount);
+
+    int minimumLevel() const;
+    void setMinimumLevel(int minimumLevel);
+
+    int maximumLevel() const;
+    void setMaximumLevel(int maximumLevel);
+
+    qreal quality() const;
+
+    qreal hysteresis() const;
+    void setHysteresis(qreal hysteresis);
+
+    qreal smoothing() const;
+    void setSmoothing(qreal smoothing);
+
+    int settleSamples() const;
+    void setSettleSamples(int settleSamples);
+
+signals:
+    void targetTimeChanged();
+    void costChanged();
+    void levelChanged();
+    void levelCountChanged();
+    void minimumLevelChanged();
+    void maximumLevelChanged();
+    void hysteresisChanged();
+    void smoothingChanged();
+    void settleSamplesChanged();
+
+private:
+    int lowestLevel() const;
+    int highestLevel() const;
+    void adjustLevel(int level, const char *reason);
+    void restartSampling();
+
+private:
+    qreal m_targetTime = 1000. / 60;
+    qreal m_cost = 0;
+    qreal m_averageCost = 0;
+    qreal m_hysteresis = 0.15;
+    qreal m_smoothing = 0.1;
+
+    int m_level = 4;
+    int m_levelCount = 5;
+    int m_minimumLevel = 0;
+    int m_maximumLevel = -1;
+    int m_settleSamples = 30;
+    int m_sampleCount = 0;
+
+    // Raising the level again right after we had to lower it would make us
+    // oscillate between two levels, so every time that happens we wait longer.
+    int m_raisedFromLevel = -1;
+    int m_raiseBackoff = 1;
+};
+
+#endif // TILEQUALITYCONTROLLER_H
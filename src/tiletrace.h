@@ -0,0 +1,210 @@
+#ifndef TILETRACE_H
+#define TILETRACE_H
+
+#include <QtCore/QtCore>
+#include <QtGui/QVector3D>
+
+#include <chrono>
+
+/**
+ * TileTrace records scoped timing events into an in-memory ring buffer, and can
+ * write them out in the Chrome trace event format, which can be loaded into
+ * chrome://tracing or Perfetto.
+ *
+ * Tracing is off unless the TILEVIEW_TRACE environment variable is set to the name
+ * of a file. The events will then be written to that file when the application
+ * exits, or on demand using TileTrace::dump() (or TileView.dumpTrace() from QML).
+ *
+ * The class is header only, so that both the TileView plugin and applications
+ * can record events without linking to each other. Each of them keeps its own
+ * buffer, and adds it to the same file using the JSON array format. The first
+ * dump of a process starts the file over, and later dumps in the same process
+ * insert their events before the closing bracket, so the file always holds one
+ * valid array with the events of one run. Timestamps are taken from the same
+ * monotonic clock, so the events line up on one timeline.
+ *
+ * Define TILEVIEW_NO_TRACE to compile the trace points out completely.
+ */
+class TileTrace
+{
+public:
+    struct Event
+    {
+        const char *name;
+        const char *argName;
+        QVector3D arg;
+        qint64 start;
+        qint64 duration;
+        quintptr thread;
+    };
+
+    static qint64 now()
+    {
+        using namespace std::chrono;
+        return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+    }
+
+    static bool isEnabled()
+    {
+        return buffer().enabled;
+    }
+
+    static void record(const char *name, const char *argName, const QVector3D &arg, qint64 start, qint64 duration)
+    {
+        Buffer &b = buffer();
+        if (!b.enabled)
+            return;
+
+        const Event event = { name, argName, arg, start, duration, quintptr(QThread::currentThreadId()) };
+        QMutexLocker locker(&b.mutex);
+        b.events[b.next] = event;
+        b.next = (b.next + 1) % b.events.count();
+        b.count = qMin(b.count + 1, b.events.count());
+    }
+
+    static bool dump(const QString &fileName)
+    {
+        return buffer().dump(fileName);
+    }
+
+private:
+    struct Buffer
+    {
+        Buffer()
+        {
+            fileName = qEnvironmentVariable("TILEVIEW_TRACE");
+            enabled = !fileName.isEmpty();
+            if (enabled) {
+                const int capacity = qEnvironmentVariableIntValue("TILEVIEW_TRACE_EVENTS");
+                events.resize(capacity > 0 ? capacity : 100000);
+            }
+        }
+
+        ~Buffer()
+        {
+            if (enabled)
+                dump(fileName);
+        }
+
+        bool dump(const QString &name)
+        {
+            const QByteArray pid = QByteArray::number(QCoreApplication::applicationPid());
+            QFile file(name);
+            const bool started = isStarted(file, pid);
+            if (!file.open(started ? QIODevice::ReadWrite : QIODevice::WriteOnly | QIODevice::Truncate)) {
+                qWarning() << "TileTrace: could not open" << name;
+                return false;
+            }
+
+            // Take the closing bracket off again, and continue the array after the last event
+            QByteArray json;
+            bool empty = true;
+            if (started && file.size() >= 4 && file.seek(file.size() - 2) && file.read(2) == "]\n") {
+                empty = file.size() == 4;
+                file.resize(file.size() - 2);
+                file.seek(file.size());
+            } else {
+                file.resize(0);
+                json += "[\n";
+            }
+
+            QMutexLocker locker(&mutex);
+            const int first = (next - count + events.count()) % qMax(1, events.count());
+            for (int i = 0; i < count; ++i) {
+                const Event &event = events[(first + i) % events.count()];
+                if (!empty)
+                    json += ",\n";
+                empty = false;
+                json += "{\"name\":\"";
+                json += event.name;
+                json += "\",\"cat\":\"tileview\",\"ph\":\"X\",\"ts\":";
+                json += QByteArray::number(event.start);
+                json += ",\"dur\":";
+                json += QByteArray::number(event.duration);
+                json += ",\"pid\":";
+                json += pid;
+                json += ",\"tid\":";
+                json += QByteArray::number(quint64(event.thread));
+                if (event.argName) {
+                    json += ",\"args\":{\"";
+                    json += event.argName;
+                    json += "\":\"";
+                    json += QByteArray::number(event.arg.x()) + ',';
+                    json += QByteArray::number(event.arg.y()) + ',';
+                    json += QByteArray::number(event.arg.z());
+                    json += "\"}";
+                }
+                json += "}";
+            }
+            count = 0;
+            locker.unlock();
+
+            json += json.isEmpty() || json.endsWith('\n') ? "]\n" : "\n]\n";
+            return file.write(json) == json.size();
+        }
+
+        // Whether this process has dumped to \a file before, possibly from another module
+        // with a buffer of its own. Their environment is shared, so it's recorded there.
+        static bool isStarted(const QFile &file, const QByteArray &pid)
+        {
+            static const char variable[] = "TILEVIEW_TRACE_STARTED";
+            const QByteArray path = QFileInfo(file).absoluteFilePath().toUtf8();
+            QList<QByteArray> started = qgetenv(variable).split('\n');
+            if (started.first() != pid)
+                started = { pid };
+            if (started.contains(path))
+                return true;
+
+            started.append(path);
+            qputenv(variable, started.join('\n'));
+            return false;
+        }
+
+        QMutex mutex;
+        QVector<Event> events;
+        int next = 0;
+        int count = 0;
+        bool enabled = false;
+        QString fileName;
+    };
+
+    static Buffer &buffer()
+    {
+        static Buffer b;
+        return b;
+    }
+};
+
+class TileTraceScope
+{
+public:
+    explicit TileTraceScope(const char *name, const char *argName = nullptr, const QVector3D &arg = QVector3D())
+        : m_name(name)
+        , m_argName(argName)
+        , m_arg(arg)
+        , m_start(TileTrace::isEnabled() ? TileTrace::now() : 0)
+    {
+    }
+
+    ~TileTraceScope()
+    {
+        if (m_start)
+            TileTrace::record(m_name, m_argName, m_arg, m_start, TileTrace::now() - m_start);
+    }
+
+private:
+    const char *m_name;
+    const char *m_argName;
+    QVector3D m_arg;
+    qint64 m_start;
+};
+
+#ifndef TILEVIEW_NO_TRACE
+#  define TILE_TRACE_CONCAT_(a, b) a##b
+#  define TILE_TRACE_CONCAT(a, b) TILE_TRACE_CONCAT_(a, b)
+#  define TILE_TRACE_SCOPE(...) TileTraceScope TILE_TRACE_CONCAT(tileTraceScope, __LINE__)(__VA_ARGS__)
+#else
+#  define TILE_TRACE_SCOPE(...)
+#endif
+
+#endif // TILETRACE_H
@@ -1,13 +1,17 @@
 #include "tileview.h"
 
 #include <QtMath>
+#include <QtQuick/QQuickWindow>
+#include <QtQuick3D/private/qquick3dobject_p.h>
+#include <QtQuick3D/private/qquick3dscenemanager_p.h>
+
+#include <algorithm>
 
 QVector3D TileView::mapTileCoordToPosition(QVector3D tileCoord) const
 {
-    const qreal coordX = m_tileCount.x() > 1 ? tileCoord.x() : 0;
-    const qreal coordY = m_tileCount.y() > 1 ? tileCoord.y() : 0;
-    const qreal coordZ = m_tileCount.z() > 1 ? tileCoord.z() : 0;
-    return QVector3D(coordX, coordY, coordZ) * m_tileSize;
+    // Axes with only one tile never roll (see mapPositionToTileCoord), so
+    // the tile coordinate along those axes will always be 0.
+    return tileCoord * m_tileSize;
 }
 
 QVector3D TileView::mapPositionToTileCoord(QVector3D position) const
@@ -18,36 +22,7 @@ QVector3D TileView::mapPositionToTileCoord(QVector3D position) const
     return QVector3D(tileX, tileY, tileZ);
 }
 
-QVector3D TileView::mapPositionToMatrixCoord(QVector3D position) const
-{
-    const QVector3D tileCoord = mapPositionToTileCoord(position);
-    const QVector3D tileOffset = m_cornerTile.tileCoord - tileCoord;
-    const int matrixX = matrixCoordShiftedX(m_cornerTile.matrixCoord.x(), -tileOffset.x());
-    const int matrixY = matrixCoordShiftedY(m_cornerTile.matrixCoord.y(), -tileOffset.y());
-    const int matrixZ = matrixCoordShiftedZ(m_cornerTile.matrixCoord.z(), -tileOffset.z());
-    return QVector3D(matrixX, matrixY, matrixZ);
-}
-
-QVector3D TileView::mapMatrixCoordToTileCoord(QVector3D matrixCoord) const
-{
-    // Return which tile that maps to to given coordinate in the matrix. Which tile
-    // that is depends on which tile the corner maps to. So we need to calculate
-    // the offset between the matrix coordinate of the corner and the given argument.
-    // This is most easily done by normalizing the corner tile so that we don't need to
-    // take wrapping into account.
-    const int coordXNorm = matrixCoordShiftedX(matrixCoord.x(), -m_cornerTile.matrixCoord.x() + (int(m_tileCount.x()) - 1));
-    const int coordYNorm = matrixCoordShiftedY(matrixCoord.y(), -m_cornerTile.matrixCoord.y() + (int(m_tileCount.y()) - 1));
-    const int coordZNorm = matrixCoordShiftedZ(matrixCoord.z(), -m_cornerTile.matrixCoord.z() + (int(m_tileCount.z()) - 1));
-    const int offsetX = coordXNorm - int(m_tileCount.x()) + 1;
-    const int offsetY = coordYNorm - int(m_tileCount.y()) + 1;
-    const int offsetZ = coordZNorm - int(m_tileCount.z()) + 1;
-    const int tileX = m_cornerTile.tileCoord.x() + offsetX;
-    const int tileY = m_cornerTile.tileCoord.y() + offsetY;
-    const int tileZ = m_cornerTile.tileCoord.z() + offsetZ;
-    return QVector3D(tileX, tileY, tileZ);
-}
-
-QVector3D TileView::mapPositionToTileCoordShifted(QVector3D position) const
+QVector3D TileView::mapPositionToTileCoordShifted(QVector3D position, const QVector3D *currentTileCoord) const
 {
     // Note: tileCoordinateShifted is an internal concept, and is only used to
     // determine when to update the tile matrix. We use tileCoordinateShifted to
@@ -55,80 +30,492 @@ QVector3D TileView::mapPositionToTileCoordShifted(QVector3D position) const
     // when the user passes the center of a tile, rather than at the edge.
     const QVector3D offset = m_tileSize / 2.;
     const QVector3D shifted(position + offset);
-    return mapPositionToTileCoord(shifted);
+    QVector3D tileCoord = mapPositionToTileCoord(shifted);
+    if (!currentTileCoord || m_rollMargin <= 0)
+        return tileCoord;
+
+    // Stay on the current tile until position is rollMargin tiles past its edge, so
+    // that moving back and forth across the edge doesn't roll the matrix back and forth.
+    for (int axis = 0; axis < 3; ++axis) {
+        const float current = (*currentTileCoord)[axis];
+        if (tileCoord[axis] == current)
+            continue;
+        const float margin = effectiveRollMargin(axis) * m_tileSize[axis];
+        const float lower = current * m_tileSize[axis] - margin;
+        const float upper = (current + 1) * m_tileSize[axis] + margin;
+        if (shifted[axis] >= lower && shifted[axis] < upper)
+            tileCoord[axis] = current;
+    }
+    return tileCoord;
+}
+
+/**
+ * The roll margin along \a axis, limited to what the window has room for. Otherwise
+ * center could move out of the window before it rolls.
+ */
+float TileView::effectiveRollMargin(int axis) const
+{
+    return qMin(m_rollMargin, qMax(0.f, (int(m_tileCount[axis]) - 2) / 2.f));
 }
 
 /**
- * The user of TileEngine is supposed to have a matrix of tileCountX() * tileCountX() size.
- * Whenever our target position moves, new rows and columns with tiles will move into the
- * current "window" of tiles that the engine at any given time covers. Since we don't want
- * to move all the tiles in the matrix, e.g one row up or down when a new row appears, to make
- * room for the new row, we simply move a "pointer" instead. This pointer is called
- * m_cornerTile.matrixCoord. m_cornerTile.matrixCoord therefore points to the cells in the matrix
- * that is furthest away from the the target pos (north-east side).
- * We can simply move the pointer since we know that when one row appears at one side of the
- * matrix, the row on the oppsite side moves out, and is free to be used to show the new row.
- *
- * This function will return the new position of startCoord (which typically will be the
- * either m_cornerTile.matrixCoord.x() or m_cornerTile.matrixCoord.y()), and give you it's new
- * position the matrix if you shift it shiftCount in one direction. This might mean that
- * it wraps around on the other side of the matrix.
+ * The position that the window is centered on, which is lookAhead tiles ahead of
+ * center along direction. It's kept close enough to center for the tile that center
+ * is on to stay inside of the window.
  */
-int TileView::matrixCoordShiftedX(int startCoord, int shiftCount) const
+QVector3D TileView::anchorPosition() const
 {
-    const int count = int(m_tileCount.x());
-    return (count + startCoord + (shiftCount % count)) % count;
+    const QVector3D direction = m_direction.normalized();
+    QVector3D anchor = m_centerPosition;
+    for (int axis = 0; axis < 3; ++axis) {
+        const float maxAhead = qMax(0.f, (int(m_tileCount[axis]) - 2) / 2.f - effectiveRollMargin(axis));
+        const float ahead = qBound(-maxAhead, direction[axis] * m_lookAhead, maxAhead);
+        anchor[axis] += ahead * m_tileSize[axis];
+    }
+    return anchor;
 }
 
-int TileView::matrixCoordShiftedY(int startCoord, int shiftCount) const
+/**
+ * Roll the tile matrix by the number of tiles that the anchor position moved across.
+ * This moves the corner tile (which is the tile that represents the delegate furthest
+ * away from the anchor along the positive axis) that the grid uses as a corner stone for
+ * calculating the tile of the other delegates in updateTiles(). Returns true if the
+ * window moved.
+ */
+bool TileView::updateWindow()
 {
-    const int count = int(m_tileCount.y());
-    return (count + startCoord + (shiftCount % count)) % count;
+    const QVector3D anchorTile = mapPositionToTileCoordShifted(anchorPosition(), &m_anchorTile);
+    const QVector3D shiftedTiles = anchorTile - m_anchorTile;
+    if (shiftedTiles.isNull())
+        return false;
+
+    m_anchorTile = anchorTile;
+    const TileGrid<3>::Coord delta = { int(shiftedTiles.x()), int(shiftedTiles.y()), int(shiftedTiles.z()) };
+
+    // Only the cells that rolled over to another tile need to be looked at again
+    m_grid.shift(delta, &m_shiftedCells);
+    for (const TileGrid<3>::Cell &cell : m_shiftedCells)
+        markTileChanged(cell.index);
+
+    for (TileLayer *layer : qAsConst(m_layers)) {
+        layer->m_grid.shift(delta, &m_shiftedCells);
+        layer->m_changedCells.insert(layer->m_changedCells.end(), m_shiftedCells.begin(), m_shiftedCells.end());
+    }
+    return true;
 }
 
-int TileView::matrixCoordShiftedZ(int startCoord, int shiftCount) const
+void TileView::markTileChanged(int index)
 {
-    const int count = int(m_tileCount.z());
-    return (count + startCoord + (shiftCount % count)) % count;
+    if (m_tileChanged[index])
+        return;
+
+    m_tileChanged[index] = true;
+    m_changedTiles.append(index);
 }
 
+/**
+ * Look at the delegate of the cell at \a index in this update. Cells that didn't
+ * get a new tile, change visibility, or were deferred, can be left alone.
+ */
+void TileView::markTileDirty(int index)
+{
+    if (m_tileDirty[index])
+        return;
+
+    m_tileDirty[index] = true;
+    m_dirtyTiles.append(index);
+}
+
+void TileView::markAllTilesChanged()
+{
+    m_changedTiles.clear();
+    m_tileChanged.fill(false, m_grid.cellCount());
+    for (int index = 0; index < m_tileChanged.count(); ++index)
+        markTileChanged(index);
+}
+
+/**
+ * Look at the bounds of the tile in the cell at \a index again in the next update.
+ * A content provider is asked until it knows them, while an attached TileView
+ * tells us when the delegate sets new bounds.
+ */
+void TileView::markBoundsPending(int index)
+{
+    if (m_boundsPending[index])
+        return;
+
+    m_boundsPending[index] = true;
+    m_pendingBounds.append(index);
+}
+
+void TileView::delegateBoundsChanged(const QObject *delegate)
+{
+    const int index = m_delegateIndices.value(delegate, -1);
+    if (index == -1 || !m_hasContent[index])
+        return;
+
+    // Cull with the new bounds without waiting for the center to move
+    markBoundsPending(index);
+    scheduleDeferredUpdate();
+}
+
+Tile TileView::mapCellToTile(const TileGrid<3>::Cell &cell) const
+{
+    Tile tile;
+    tile.matrixCoord = QVector3D(cell.matrixCoord[0], cell.matrixCoord[1], cell.matrixCoord[2]);
+    tile.tileCoord = QVector3D(cell.tileCoord[0], cell.tileCoord[1], cell.tileCoord[2]);
+    tile.position = mapTileCoordToPosition(tile.tileCoord);
+    tile.delegate = m_delegateNodes.value(cell.index);
+    return tile;
+}
+
+/**
+ * The user of TileView is supposed to have a matrix of tileCount.x * tileCount.y * tileCount.z
+ * delegates. Whenever center moves, new rows and columns with tiles will move into the
+ * current "window" of tiles that the view at any given time covers. The bookkeeping of which
+ * delegate in the matrix shows which tile is done by m_grid (see TileGrid), which rolls the
+ * matrix as a ring buffer rather than moving the delegates around.
+ */
 void TileView::resetAllTiles()
 {
     if (!isComponentComplete())
         return;
 
-    m_cornerTile.matrixCoord = QVector3D(int(m_tileCount.x()) - 1, int(m_tileCount.y()) - 1, int(m_tileCount.z()) - 1);
-    m_cornerTile.tileCoord = m_cornerTile.matrixCoord;
-    m_cornerTile.position = mapTileCoordToPosition(m_cornerTile.tileCoord);
+    m_anchorTile = mapPositionToTileCoordShifted(anchorPosition());
+    m_grid.reset({ int(m_tileCount.x()), int(m_tileCount.y()), int(m_tileCount.z()) },
+                 { int(m_anchorTile.x()), int(m_anchorTile.y()), int(m_anchorTile.z()) });
+    m_chunkTree.reset(m_grid.count());
 
+    evictAllContent();
     recreateDelegates();
 
-    Tile tile;
-    for (int matrixZ = 0; matrixZ < int(m_tileCount.z()); ++matrixZ) {
-        for (int matrixY = 0; matrixY < int(m_tileCount.y()); ++matrixY) {
-            for (int matrixX = 0; matrixX < int(m_tileCount.x()); ++matrixX) {
-                tile.matrixCoord = QVector3D(matrixX, matrixY, matrixZ);
-                tile.tileCoord = tile.matrixCoord;
-                tile.position = mapTileCoordToPosition(tile.tileCoord);
-                updateDelegate(tile);
+    m_contentTiles.fill(Tile(), m_grid.cellCount());
+    m_hasContent.fill(false, m_grid.cellCount());
+    m_tiles.resize(m_grid.cellCount());
+    m_grid.forEachCell([this](const TileGrid<3>::Cell &cell) {
+        m_tiles[cell.index] = mapCellToTile(cell);
+    });
+    markAllTilesChanged();
+    m_pendingBounds.clear();
+    m_boundsPending.fill(false, m_grid.cellCount());
+    m_dirtyTiles.clear();
+    m_tileDirty.fill(false, m_grid.cellCount());
+    m_deferredTiles.clear();
+    m_tileDeferred.fill(false, m_grid.cellCount());
+    for (TileLayer *layer : qAsConst(m_layers))
+        resetLayer(layer);
+    updateTiles();
+
+    emit windowChanged();
+}
+
+/**
+ * A layer covers the tiles in the middle of the window, as many as its tileCount says
+ * along each axis (or all of them, if it's 0 or more than the view has), rounded up to
+ * the same parity as the view's tileCount so that it is centered in the window. It keeps a grid
+ * of its own for that, which is reset and rolled together with m_grid, so that the two
+ * always agree on which tiles are in the window.
+ */
+void TileView::resetLayer(TileLayer *layer)
+{
+    if (!isComponentComplete())
+        return;
+
+    qDeleteAll(layer->m_delegateNodes);
+    layer->m_delegateNodes.clear();
+
+    const TileGrid<3>::Coord viewCount = m_grid.count();
+    const TileGrid<3>::Coord viewOrigin = m_grid.originTile();
+    TileGrid<3>::Coord count;
+    TileGrid<3>::Coord origin;
+    for (int axis = 0; axis < 3; ++axis) {
+        const int layerCount = int(layer->m_tileCount[axis]);
+        count[axis] = layerCount > 0 ? qMin(layerCount, viewCount[axis]) : viewCount[axis];
+        // Leave as many tiles out on either side (see TileLayer::setTileCount)
+        if ((viewCount[axis] - count[axis]) % 2 != 0)
+            ++count[axis];
+        origin[axis] = viewOrigin[axis] + (viewCount[axis] - count[axis]) / 2;
+    }
+    layer->m_grid.reset(count, origin);
+
+    const int delegateCount = layer->m_grid.cellCount();
+    if (layer->m_delegate) {
+        TILE_TRACE_SCOPE("recreateLayerDelegates");
+        layer->m_delegateNodes.reserve(delegateCount);
+        for (int i = 0; i < delegateCount; ++i)
+            layer->m_delegateNodes.append(createDelegate(layer->m_delegate, layer->m_name));
+    }
+
+    layer->m_contentTiles.fill(QVector3D(), delegateCount);
+    layer->m_hasContent.fill(false, delegateCount);
+
+    layer->m_changedCells.clear();
+    layer->m_grid.forEachCell([layer](const TileGrid<3>::Cell &cell) {
+        layer->m_changedCells.push_back(cell);
+    });
+}
+
+QVector3D TileView::mapTileToDelegatePosition(const Tile &tile) const
+{
+    const QVector3D centerVector((int(m_tileCount.x()) - 1) * m_tileSize.x() / 2,
+                                 (int(m_tileCount.y()) - 1) * m_tileSize.y() / 2,
+                                 (int(m_tileCount.z()) - 1) * m_tileSize.z() / 2);
+    return tile.position - centerVector;
+}
+
+/**
+ * Update the bounding box of the cell at \a index in the chunk tree. Returns true if
+ * the box came from the delegate, or false if we had to make one up for now.
+ */
+bool TileView::updateTileBounds(const Tile &tile, int index)
+{
+    const QVector3D delegatePosition = mapTileToDelegatePosition(tile);
+    const bool hasContent = m_hasContent[index] && m_contentTiles[index].tileCoord == tile.tileCoord;
+
+    if (hasContent) {
+        QVector3D minimum;
+        QVector3D maximum;
+        if (TileContentProvider *contentProvider = provider()) {
+            if (contentProvider->tileBounds(m_contentTiles[index], &minimum, &maximum)) {
+                m_chunkTree.setBounds(index, delegatePosition + minimum, delegatePosition + maximum);
+                return true;
+            }
+        } else {
+            const TileViewAttached *attached = getAttachedObject(m_delegateNodes[index]);
+            if (attached->hasBounds()) {
+                m_chunkTree.setBounds(index, delegatePosition + attached->boundsMin(), delegatePosition + attached->boundsMax());
+                return true;
             }
         }
     }
+
+    // The delegate doesn't know (yet) what it will look like for this tile, so
+    // assume that it fills the tile along the positive axes from its position.
+    m_chunkTree.setBounds(index, delegatePosition, delegatePosition + m_tileSize);
+    return false;
 }
 
 void TileView::updateTiles()
 {
-    Tile tile;
-    for (int matrixZ = 0; matrixZ < int(m_tileCount.z()); ++matrixZ) {
-        for (int matrixY = 0; matrixY < int(m_tileCount.y()); ++matrixY) {
-            for (int matrixX = 0; matrixX < int(m_tileCount.x()); ++matrixX) {
-                tile.matrixCoord = QVector3D(matrixX, matrixY, matrixZ);
-                tile.tileCoord = mapMatrixCoordToTileCoord(tile.matrixCoord);
-                tile.position = mapTileCoordToPosition(tile.tileCoord);
-                updateDelegate(tile);
-            }
+    TILE_TRACE_SCOPE("updateTiles");
+
+    for (int index : qAsConst(m_changedTiles)) {
+        const QVector3D &m = m_tiles[index].matrixCoord;
+        m_tiles[index] = mapCellToTile(m_grid.cellAt({ int(m.x()), int(m.y()), int(m.z()) }));
+        m_tileChanged[index] = false;
+        markTileDirty(index);
+
+        // The cell can roll back to a tile that it still has content for
+        if (!updateTileBounds(m_tiles[index], index) && !needsContent(index))
+            markBoundsPending(index);
+    }
+    m_changedTiles.clear();
+
+    // A content provider might only know the bounds of a tile some time after
+    // it was assigned, so keep asking until it does, or the content is gone.
+    for (int i = m_pendingBounds.count() - 1; i >= 0; --i) {
+        const int index = m_pendingBounds[i];
+        const bool known = updateTileBounds(m_tiles[index], index);
+        if (known || !provider() || needsContent(index)) {
+            m_boundsPending[index] = false;
+            m_pendingBounds[i] = m_pendingBounds.last();
+            m_pendingBounds.removeLast();
         }
     }
+
+    // Cull the tiles that are behind the camera chunk by chunk, rather than tile by tile
+    m_culledTiles.clear();
+    m_chunkTree.updateVisibility(m_centerPosition, m_direction, &m_tileVisible, &m_culledTiles);
+    for (int index : qAsConst(m_culledTiles))
+        markTileDirty(index);
+
+    // The tiles held back by the last update get another chance
+    for (int index : qAsConst(m_deferredTiles))
+        markTileDirty(index);
+    deferContentOverBudget();
+
+    for (int index : qAsConst(m_dirtyTiles))
+        updateDelegate(m_tiles[index]);
+
+    flushContentChanges();
+
+    // The content provider has been told about the new tiles by now, so the
+    // layers see the content that it put into the view's own delegates.
+    for (TileLayer *layer : qAsConst(m_layers))
+        updateLayer(layer);
+
+    for (int index : qAsConst(m_dirtyTiles))
+        m_tileDirty[index] = false;
+    m_dirtyTiles.clear();
+}
+
+/**
+ * Show the delegates in \a layer for the tiles that the view's own delegates are shown
+ * for, and assign them new tiles through the attached TileView.tile property. The
+ * layer doesn't do any culling or budgeting of its own, but follows the view. Only the
+ * cells that got a new tile in the layer, or whose tile is dirty in the view, are updated.
+ */
+void TileView::updateLayer(TileLayer *layer)
+{
+    if (layer->m_delegateNodes.isEmpty()) {
+        layer->m_changedCells.clear();
+        return;
+    }
+
+    for (int viewIndex : qAsConst(m_dirtyTiles)) {
+        const QVector3D &t = m_tiles[viewIndex].tileCoord;
+        const TileGrid<3>::Coord tileCoord = { int(t.x()), int(t.y()), int(t.z()) };
+        if (!layer->m_grid.contains(tileCoord))
+            continue;
+        const TileGrid<3>::Coord matrixCoord = layer->m_grid.matrixCoordOf(tileCoord);
+        layer->m_changedCells.push_back({ tileCoord, matrixCoord, layer->m_grid.indexOf(matrixCoord) });
+    }
+
+    for (const TileGrid<3>::Cell &cell : layer->m_changedCells) {
+        const int viewIndex = m_grid.indexOf(m_grid.matrixCoordOf(cell.tileCoord));
+        const Tile &tile = m_tiles[viewIndex];
+        QQuick3DNode *node = layer->m_delegateNodes[cell.index];
+
+        const bool visible = m_tileVisible[viewIndex] && !m_tileDeferred[viewIndex];
+        node->setVisible(visible);
+        if (!visible)
+            continue;
+
+        node->setPosition(mapTileToDelegatePosition(tile));
+        if (layer->m_hasContent[cell.index] && layer->m_contentTiles[cell.index] == tile.tileCoord)
+            continue;
+
+        layer->m_contentTiles[cell.index] = tile.tileCoord;
+        layer->m_hasContent[cell.index] = true;
+
+        TILE_TRACE_SCOPE("assignLayerTile", "tile", tile.tileCoord);
+        getAttachedObject(node)->setTile(tile.tileCoord);
+    }
+    layer->m_changedCells.clear();
+}
+
+bool TileView::needsContent(int index) const
+{
+    return !m_hasContent[index] || m_contentTiles[index].tileCoord != m_tiles[index].tileCoord;
+}
+
+/**
+ * Limit the number of delegates that are assigned new content in one update to
+ * updateBudget, starting with the ones closest to center. The rest are kept hidden
+ * for now, and picked up by another update in the next frame (see scheduleDeferredUpdate).
+ * That way a big roll of the matrix is spread out over several frames.
+ */
+void TileView::deferContentOverBudget()
+{
+    for (int index : qAsConst(m_deferredTiles))
+        m_tileDeferred[index] = false;
+    m_deferredTiles.clear();
+    if (m_updateBudget <= 0)
+        return;
+
+    // A tile can only need content if it got a new tile, became visible, or was
+    // deferred by the last update, which are the dirty tiles.
+    QVector<int> candidates;
+    for (int index : qAsConst(m_dirtyTiles)) {
+        if (m_tileVisible[index] && needsContent(index))
+            candidates.append(index);
+    }
+
+    if (candidates.count() <= m_updateBudget)
+        return;
+
+    const auto distance = [this](int index) {
+        return (mapTileToDelegatePosition(m_tiles[index]) + (m_tileSize / 2) - m_centerPosition).lengthSquared();
+    };
+    std::nth_element(candidates.begin(), candidates.begin() + m_updateBudget, candidates.end(),
+                     [&](int a, int b) { return distance(a) < distance(b); });
+    for (int i = m_updateBudget; i < candidates.count(); ++i) {
+        m_tileDeferred[candidates[i]] = true;
+        m_deferredTiles.append(candidates[i]);
+    }
+
+    scheduleDeferredUpdate();
+}
+
+/**
+ * Update the tiles again when the window that shows the view animates its next frame,
+ * which is where the deferred tiles are supposed to go. Several rounds of the event loop
+ * can pass between two frames, and updating in each of them would only spend the budget
+ * of a single frame several times over.
+ */
+void TileView::scheduleDeferredUpdate()
+{
+    if (m_updatePending)
+        return;
+
+    m_updatePending = true;
+    const auto update = [this] {
+        m_updatePending = false;
+        updateTiles();
+    };
+
+    QQuick3DObjectPrivate *d = QQuick3DObjectPrivate::get(this);
+    QQuickWindow *window = d->sceneManager ? d->sceneManager->window() : nullptr;
+    if (!window) {
+        // Not shown (yet), so there are no frames to wait for
+        QMetaObject::invokeMethod(this, update, Qt::QueuedConnection);
+        return;
+    }
+
+    connect(window, &QQuickWindow::afterAnimating, this, update, Qt::SingleShotConnection);
+    window->update();
+}
+
+TileContentProvider *TileView::provider() const
+{
+    return qobject_cast<TileContentProvider *>(m_contentProvider.data());
+}
+
+bool TileView::contentTileOf(const QQuick3DNode *node, QVector3D *tile) const
+{
+    const int index = m_delegateIndices.value(node, -1);
+    if (index != -1) {
+        *tile = m_contentTiles[index].tileCoord;
+        return m_hasContent[index];
+    }
+
+    for (const TileLayer *layer : m_layers) {
+        const int layerIndex = layer->m_delegateNodes.indexOf(const_cast<QQuick3DNode *>(node));
+        if (layerIndex != -1) {
+            *tile = layer->m_contentTiles[layerIndex];
+            return layer->m_hasContent[layerIndex];
+        }
+    }
+
+    return false;
+}
+
+void TileView::evictAllContent()
+{
+    for (int index = 0; index < m_hasContent.count(); ++index) {
+        if (m_hasContent[index])
+            m_evictedTiles.append(m_contentTiles[index]);
+    }
+    m_hasContent.fill(false);
+    flushContentChanges();
+}
+
+void TileView::flushContentChanges()
+{
+    if (TileContentProvider *contentProvider = provider()) {
+        if (!m_evictedTiles.isEmpty())
+            contentProvider->tilesEvicted(m_evictedTiles);
+        if (!m_assignedTiles.isEmpty()) {
+            TILE_TRACE_SCOPE("tilesAssigned");
+            contentProvider->tilesAssigned(m_assignedTiles);
+        }
+        if (!m_visibilityChangedTiles.isEmpty())
+            contentProvider->tilesVisibilityChanged(m_visibilityChangedTiles);
+    }
+
+    m_evictedTiles.clear();
+    m_assignedTiles.clear();
+    m_visibilityChangedTiles.clear();
 }
 
 // *******************************************************************
@@ -150,53 +537,133 @@ TileViewAttached *TileView::qmlAttachedProperties(QObject *obj)
     return new TileViewAttached(obj);
 }
 
+void TileView::appendLayer(QQmlListProperty<TileLayer> *list, TileLayer *layer)
+{
+    if (!layer)
+        return;
+
+    TileView *view = static_cast<TileView *>(list->object);
+    view->m_layers.append(layer);
+
+    const auto reset = [view, layer] {
+        if (!view->isComponentComplete())
+            return;
+        view->resetLayer(layer);
+        view->updateTiles();
+    };
+    connect(layer, &TileLayer::nameChanged, view, reset);
+    connect(layer, &TileLayer::delegateChanged, view, reset);
+    connect(layer, &TileLayer::tileCountChanged, view, reset);
+    reset();
+}
+
+qsizetype TileView::layerCount(QQmlListProperty<TileLayer> *list)
+{
+    return static_cast<TileView *>(list->object)->m_layers.count();
+}
+
+TileLayer *TileView::layerAt(QQmlListProperty<TileLayer> *list, qsizetype index)
+{
+    return static_cast<TileView *>(list->object)->m_layers.at(index);
+}
+
+void TileView::clearLayers(QQmlListProperty<TileLayer> *list)
+{
+    TileView *view = static_cast<TileView *>(list->object);
+    for (TileLayer *layer : qAsConst(view->m_layers)) {
+        disconnect(layer, nullptr, view, nullptr);
+        qDeleteAll(layer->m_delegateNodes);
+        layer->m_delegateNodes.clear();
+        layer->m_hasContent.clear();
+    }
+    view->m_layers.clear();
+}
+
 // *******************************************************************
 
 void TileView::recreateDelegates()
 {
+    TILE_TRACE_SCOPE("recreateDelegates");
+
     qDeleteAll(m_delegateNodes);
     m_delegateNodes.clear();
+    m_delegateIndices.clear();
 
     const int delegateCount = int(m_tileCount.x()) * int(m_tileCount.y()) * int(m_tileCount.z());
     m_delegateNodes.reserve(delegateCount);
 
     // Create all delegate items
     for (int i = 0; i < delegateCount; ++i) {
-        QObject *obj = m_delegate->create();
-        QQuick3DNode *node = qobject_cast<QQuick3DNode *>(obj);
-        if (!node) {
-            qmlWarning(this) << "Delegate is not a Node";
-            delete node;
-            node = new QQuick3DNode();
-        }
-        node->setParentItem(this);
-        node->setParent(this);
-        node->setVisible(false);
-        getAttachedObject(node)->setView(this);
-        m_delegateNodes.append(node);
+        m_delegateNodes.append(createDelegate(m_delegate, QString()));
+        m_delegateIndices.insert(m_delegateNodes.last(), i);
     }
 }
 
+QQuick3DNode *TileView::createDelegate(QQmlComponent *component, const QString &layerName)
+{
+    TILE_TRACE_SCOPE("createDelegate");
+    QObject *obj = component->create();
+    QQuick3DNode *node = qobject_cast<QQuick3DNode *>(obj);
+    if (!node) {
+        qmlWarning(this) << "Delegate is not a Node";
+        delete obj;
+        node = new QQuick3DNode();
+    }
+    node->setParentItem(this);
+    node->setParent(this);
+    node->setVisible(false);
+    TileViewAttached *attached = getAttachedObject(node);
+    attached->setView(this);
+    attached->setLayer(layerName);
+    return node;
+}
+
 void TileView::updateDelegate(const Tile &tile)
 {
-    int index = tile.matrixCoord.x()
-            + (tile.matrixCoord.y() * int(m_tileCount.x()))
-            + (tile.matrixCoord.z() * int(m_tileCount.x()) * int(m_tileCount.y()));
+    const TileGrid<3>::Coord matrixCoord = { int(tile.matrixCoord.x()), int(tile.matrixCoord.y()), int(tile.matrixCoord.z()) };
+    const int index = m_grid.indexOf(matrixCoord);
     QQuick3DNode *node = m_delegateNodes[index];
 
-    const QVector3D centerVector((int(m_tileCount.x()) - 1) * m_tileSize.x() / 2,
-                                 (int(m_tileCount.y()) - 1) * m_tileSize.y() / 2,
-                                 (int(m_tileCount.z()) - 1) * m_tileSize.z() / 2);
-    const QVector3D delegatePosition = tile.position - centerVector;
+    // A deferred tile stays hidden rather than showing the content of the tile it had before
+    const bool visible = m_tileVisible[index] && !m_tileDeferred[index];
+    if (node->visible() != visible) {
+        node->setVisible(visible);
+        Tile changedTile = tile;
+        changedTile.visible = visible;
+        m_visibilityChangedTiles.append(changedTile);
+    }
 
-    const qreal tileSize = qMax(qMax(m_tileSize.x(), m_tileSize.y()), m_tileSize.z());
-    const float inFrontOfCamera = QVector3D::dotProduct(delegatePosition - m_centerPosition, m_direction) > -tileSize / 2;
-    node->setVisible(inFrontOfCamera || m_direction.isNull());
+    // Only tell the delegate to update / rebuild if it's actually visible
+    if (!visible)
+        return;
 
-    if (node->visible()) {
-        // Only tell the delegate to update / rebuild if it's actually visible
-        node->setPosition(delegatePosition);
-        getAttachedObject(node)->setTile(tile.tileCoord);
+    const bool newContent = needsContent(index);
+    TileContentProvider *contentProvider = provider();
+    TileViewAttached *attached = contentProvider ? nullptr : getAttachedObject(node);
+
+    // Bounds reported by the delegate for the tile it showed before are no longer valid
+    if (newContent && attached)
+        attached->resetBounds();
+
+    node->setPosition(mapTileToDelegatePosition(tile));
+
+    if (!newContent)
+        return;
+
+    if (m_hasContent[index])
+        m_evictedTiles.append(m_contentTiles[index]);
+
+    Tile assignedTile = tile;
+    assignedTile.visible = true;
+    m_contentTiles[index] = assignedTile;
+    m_hasContent[index] = true;
+    markBoundsPending(index);
+
+    if (contentProvider) {
+        m_assignedTiles.append(assignedTile);
+    } else {
+        TILE_TRACE_SCOPE("assignTile", "tile", tile.tileCoord);
+        attached->setTile(tile.tileCoord);
     }
 }
 
@@ -210,6 +677,8 @@ TileView::TileView(QQuick3DNode *parent)
 TileView::~TileView()
 {
     qDeleteAll(m_delegateNodes);
+    for (TileLayer *layer : qAsConst(m_layers))
+        qDeleteAll(layer->m_delegateNodes);
 }
 
 QQmlComponent *TileView::delegate() const
@@ -227,6 +696,110 @@ void TileView::setDelegate(QQmlComponent *delegate)
     emit delegateChanged();
 }
 
+QObject *TileView::contentProvider() const
+{
+    return m_contentProvider;
+}
+
+void TileView::setContentProvider(QObject *contentProvider)
+{
+    if (m_contentProvider == contentProvider)
+        return;
+
+    if (contentProvider && !qobject_cast<TileContentProvider *>(contentProvider))
+        qmlWarning(this) << "contentProvider does not implement TileContentProvider";
+
+    // Let the old provider release its content before we hand the tiles over to the new one
+    evictAllContent();
+    m_contentProvider = contentProvider;
+    resetAllTiles();
+    emit contentProviderChanged();
+}
+
+int TileView::updateBudget() const
+{
+    return m_updateBudget;
+}
+
+/**
+ * The maximum number of delegates that will be assigned new content per update, or 0
+ * for no limit. Delegates over the budget are hidden until a later update gets to them.
+ */
+void TileView::setUpdateBudget(int updateBudget)
+{
+    updateBudget = qMax(0, updateBudget);
+    if (m_updateBudget == updateBudget)
+        return;
+
+    m_updateBudget = updateBudget;
+    if (isComponentComplete())
+        updateTiles();
+    emit updateBudgetChanged();
+}
+
+/**
+ * Layers of delegates that are shown for the same tiles as the view's own delegate,
+ * like foliage or buildings on top of the ground. They are updated in order, after
+ * the view's own delegates.
+ */
+QQmlListProperty<TileLayer> TileView::layers()
+{
+    return QQmlListProperty<TileLayer>(this, nullptr, &TileView::appendLayer, &TileView::layerCount,
+                                       &TileView::layerAt, &TileView::clearLayers);
+}
+
+/**
+ * Returns the delegate in the layer called \a layerName that shows \a tile, or the
+ * view's own delegate for it if \a layerName is empty. Returns null if the tile is outside
+ * of the layer, or no delegate in the layer has been assigned the tile yet.
+ */
+QQuick3DNode *TileView::layerDelegate(const QString &layerName, const QVector3D &tile) const
+{
+    const TileGrid<3>::Coord tileCoord = { int(tile.x()), int(tile.y()), int(tile.z()) };
+
+    if (layerName.isEmpty()) {
+        if (!m_grid.contains(tileCoord))
+            return nullptr;
+        const int index = m_grid.indexOf(m_grid.matrixCoordOf(tileCoord));
+        if (!m_hasContent.value(index) || m_contentTiles[index].tileCoord != tile)
+            return nullptr;
+        return m_delegateNodes.value(index);
+    }
+
+    for (const TileLayer *layer : m_layers) {
+        if (layer->m_name != layerName || !layer->m_grid.contains(tileCoord))
+            continue;
+        const int index = layer->m_grid.indexOf(layer->m_grid.matrixCoordOf(tileCoord));
+        if (layer->m_hasContent.value(index) && layer->m_contentTiles[index] == tile)
+            return layer->m_delegateNodes.value(index);
+    }
+
+    return nullptr;
+}
+
+bool TileView::dumpTrace(const QString &fileName)
+{
+    return TileTrace::dump(fileName);
+}
+
+/**
+ * The area covered by the tiles in the view, assuming that each
+ * delegate covers tileSize along the positive axes from its position.
+ */
+QVector3D TileView::windowMin() const
+{
+    const TileGrid<3>::Coord origin = m_grid.originTile();
+    Tile tile;
+    tile.position = mapTileCoordToPosition(QVector3D(origin[0], origin[1], origin[2]));
+    return mapTileToDelegatePosition(tile);
+}
+
+QVector3D TileView::windowMax() const
+{
+    const TileGrid<3>::Coord count = m_grid.count();
+    return windowMin() + QVector3D(count[0], count[1], count[2]) * m_tileSize;
+}
+
 QVector3D TileView::center() const
 {
     return m_centerPosition;
@@ -258,7 +831,13 @@ void TileView::setTileSize(QVector3D tileSize)
         return;
 
     m_tileSize = tileSize;
+    if (isComponentComplete()) {
+        // Every tile moves to a new position
+        markAllTilesChanged();
+        updateTiles();
+    }
     emit tileSizeChanged();
+    emit windowChanged();
 }
 
 void TileView::setCenter(const QVector3D &center)
@@ -266,32 +845,18 @@ void TileView::setCenter(const QVector3D &center)
     if (center == m_centerPosition)
         return;
 
-    const QVector3D oldCenterPosition = m_centerPosition;
+    TILE_TRACE_SCOPE("setCenter", "center", center);
+
     m_centerPosition = center;
 
     if (!isComponentComplete())
         return;
 
-    // Update the corner tile (which is the tile that represents the delegate
-    // furthest away from center along the positive axis). This will by used as
-    // a corner stone for calculating the position of the other delegate in updateTiles().
-    const QVector3D oldTileCoord = mapPositionToTileCoordShifted(oldCenterPosition);
-    const QVector3D newTileCoord = mapPositionToTileCoordShifted(m_centerPosition);
-    const QVector3D shiftedTiles = newTileCoord - oldTileCoord;
-
-    m_cornerTile.tileCoord += shiftedTiles;
-
-    const int cornerX = int(m_cornerTile.matrixCoord.x());
-    const int newCornerX = matrixCoordShiftedX(cornerX, shiftedTiles.x());
-    const int cornerY = int(m_cornerTile.matrixCoord.y());
-    const int newCornerY = matrixCoordShiftedY(cornerY, shiftedTiles.y());
-    const int cornerZ = int(m_cornerTile.matrixCoord.z());
-    const int newCornerZ = matrixCoordShiftedZ(cornerZ, shiftedTiles.z());
-
-    m_cornerTile.matrixCoord = QVector3D(newCornerX, newCornerY, newCornerZ);
-
+    const bool windowMoved = updateWindow();
     updateTiles();
 
+    if (windowMoved)
+        emit windowChanged();
     emit centerChanged();
 }
 
@@ -306,10 +871,61 @@ void TileView::setDirection(QVector3D direction)
         return;
 
     m_direction = direction;
+
+    // With lookAhead, turning around moves the window as well
+    const bool windowMoved = isComponentComplete() && updateWindow();
     updateTiles();
+
+    if (windowMoved)
+        emit windowChanged();
     emit directionChanged();
 }
 
+float TileView::lookAhead() const
+{
+    return m_lookAhead;
+}
+
+/**
+ * The number of tiles that the window is moved ahead of center along direction. With a
+ * camera that looks forward, this puts more of the tiles in front of it, rather than
+ * behind it, where they would be culled. The default is 0, which keeps center in the
+ * middle of the window. The window never moves so far that center falls outside of it.
+ */
+void TileView::setLookAhead(float lookAhead)
+{
+    if (qFuzzyCompare(m_lookAhead, lookAhead))
+        return;
+
+    m_lookAhead = lookAhead;
+    if (isComponentComplete() && updateWindow()) {
+        updateTiles();
+        emit windowChanged();
+    }
+    emit lookAheadChanged();
+}
+
+float TileView::rollMargin() const
+{
+    return m_rollMargin;
+}
+
+/**
+ * How far (as a fraction of a tile) center needs to move past the point where the
+ * window would otherwise roll, before it actually rolls. This stops the window from
+ * rolling back and forth when center moves around near that point. The default is 0.
+ * Along axes with few tiles, the margin is limited so that center stays in the window.
+ */
+void TileView::setRollMargin(float rollMargin)
+{
+    rollMargin = qMax(0.f, rollMargin);
+    if (qFuzzyCompare(m_rollMargin, rollMargin))
+        return;
+
+    m_rollMargin = rollMargin;
+    emit rollMarginChanged();
+}
+
 TileViewAttached::TileViewAttached(QObject *parent)
     : QObject(parent)
 {
@@ -329,6 +945,84 @@ void TileViewAttached::setView(TileView *tileView)
     emit viewChanged();
 }
 
+QVector3D TileViewAttached::boundsMin() const
+{
+    return m_boundsMin;
+}
+
+void TileViewAttached::setBoundsMin(const QVector3D &boundsMin)
+{
+    const bool hadBounds = hasBounds();
+    const bool changed = m_boundsMin != boundsMin;
+    m_hasBoundsMin = true;
+    m_boundsMin = boundsMin;
+
+    // Let the view cull the delegate with the new bounds
+    if (m_view && (changed || hadBounds != hasBounds()))
+        m_view->delegateBoundsChanged(parent());
+    if (changed)
+        emit boundsMinChanged();
+}
+
+QVector3D TileViewAttached::boundsMax() const
+{
+    return m_boundsMax;
+}
+
+void TileViewAttached::setBoundsMax(const QVector3D &boundsMax)
+{
+    const bool hadBounds = hasBounds();
+    const bool changed = m_boundsMax != boundsMax;
+    m_hasBoundsMax = true;
+    m_boundsMax = boundsMax;
+
+    // Let the view cull the delegate with the new bounds
+    if (m_view && (changed || hadBounds != hasBounds()))
+        m_view->delegateBoundsChanged(parent());
+    if (changed)
+        emit boundsMaxChanged();
+}
+
+bool TileViewAttached::hasBounds() const
+{
+    return m_hasBoundsMin && m_hasBoundsMax;
+}
+
+void TileViewAttached::resetBounds()
+{
+    // Keep the values, but wait until the delegate
+    // assigns them again before we start using them.
+    m_hasBoundsMin = false;
+    m_hasBoundsMax = false;
+}
+
+QString TileViewAttached::layer() const
+{
+    return m_layer;
+}
+
+void TileViewAttached::setLayer(const QString &layer)
+{
+    if (m_layer == layer)
+        return;
+
+    m_layer = layer;
+    emit layerChanged();
+}
+
+/**
+ * Returns the delegate in the layer called \a layerName that shows the same tile as
+ * this delegate (see TileView::layerDelegate). A layer can use this to build on
+ * what the layers before it show for the tile, like the height of the ground.
+ */
+QQuick3DNode *TileViewAttached::layerDelegate(const QString &layerName) const
+{
+    QVector3D tile;
+    if (!m_view || !m_view->contentTileOf(qobject_cast<const QQuick3DNode *>(parent()), &tile))
+        return nullptr;
+    return m_view->layerDelegate(layerName, tile);
+}
+
 QVector3D TileViewAttached::tile() const
 {
     return m_tile;
@@ -346,3 +1040,58 @@ void TileViewAttached::setTile(const QVector3D &tile)
     m_tile = tile;
     emit tileChanged();
 }
+
+// *******************************************************************
+
+TileLayer::TileLayer(QObject *parent)
+    : QObject(parent)
+{
+}
+
+QString TileLayer::name() const
+{
+    return m_name;
+}
+
+void TileLayer::setName(const QString &name)
+{
+    if (m_name == name)
+        return;
+
+    m_name = name;
+    emit nameChanged();
+}
+
+QQmlComponent *TileLayer::delegate() const
+{
+    return m_delegate;
+}
+
+void TileLayer::setDelegate(QQmlComponent *delegate)
+{
+    if (m_delegate == delegate)
+        return;
+
+    m_delegate = delegate;
+    emit delegateChanged();
+}
+
+QVector3D TileLayer::tileCount() const
+{
+    return m_tileCount;
+}
+
+/**
+ * The number of tiles in the middle of the window that the layer covers along each
+ * axis. Axes that are left at 0 (the default) cover the same tiles as the view. A
+ * count can only be centered in the window if it's even when the view's tileCount is
+ * even, and odd when it's odd, so otherwise the layer covers one tile more.
+ */
+void TileLayer::setTileCount(const QVector3D &tileCount)
+{
+    if (m_tileCount == tileCount)
+        return;
+
+    m_tileCount = tileCount;
+    emit tileCountChanged();
+}
@@ -6,15 +6,59 @@
 #include <QtQuick3D/QtQuick3D>
 #include <QtQuick3D/private/qquick3dnode_p.h>
 
-struct Tile
-{
-    QVector3D position;
-    QVector3D tileCoord;
-    QVector3D matrixCoord;
-};
+#include "tilechunktree.h"
+#include "tilecontentprovider.h"
+#include "tilegrid.h"
+#include "tiletrace.h"
 
 class TileViewAttached;
 
+/**
+ * A TileLayer adds another set of delegates on top of the tiles in a TileView.
+ * All layers follow the same window, and show and hide their delegates together
+ * with the TileView's own delegate for the same tile.
+ */
+class TileLayer : public QObject
+{
+    Q_OBJECT
+    QML_ELEMENT
+
+    Q_PROPERTY(QString name READ name WRITE setName NOTIFY nameChanged)
+    Q_PROPERTY(QQmlComponent *delegate READ delegate WRITE setDelegate NOTIFY delegateChanged)
+    Q_PROPERTY(QVector3D tileCount READ tileCount WRITE setTileCount NOTIFY tileCountChanged)
+
+public:
+    explicit TileLayer(QObject *parent = nullptr);
+
+    QString name() const;
+    void setName(const QString &name);
+
+    QQmlComponent *delegate() const;
+    void setDelegate(QQmlComponent *delegate);
+
+    QVector3D tileCount() const;
+    void setTileCount(const QVector3D &tileCount);
+
+signals:
+    void nameChanged();
+    void delegateChanged();
+    void tileCountChanged();
+
+private:
+    friend class TileView;
+
+    QString m_name;
+    QQmlComponent *m_delegate = nullptr;
+    QVector3D m_tileCount;
+
+    // The bookkeeping below is done by the view that the layer belongs to
+    TileGrid<3> m_grid;
+    QVector<QQuick3DNode *> m_delegateNodes;
+    QVector<QVector3D> m_contentTiles;
+    QVector<bool> m_hasContent;
+    std::vector<TileGrid<3>::Cell> m_changedCells;
+};
+
 class TileView : public QQuick3DNode
 {
     Q_OBJECT
@@ -26,7 +70,14 @@ class TileView : public QQuick3DNode
     Q_PROPERTY(QVector3D tileSize READ tileSize WRITE setTileSize NOTIFY tileSizeChanged)
     Q_PROPERTY(QVector3D center READ center WRITE setCenter NOTIFY centerChanged)
     Q_PROPERTY(QVector3D direction READ direction WRITE setDirection NOTIFY directionChanged)
+    Q_PROPERTY(float lookAhead READ lookAhead WRITE setLookAhead NOTIFY lookAheadChanged)
+    Q_PROPERTY(float rollMargin READ rollMargin WRITE setRollMargin NOTIFY rollMarginChanged)
     Q_PROPERTY(QQmlComponent *delegate READ delegate WRITE setDelegate NOTIFY delegateChanged)
+    Q_PROPERTY(QObject *contentProvider READ contentProvider WRITE setContentProvider NOTIFY contentProviderChanged)
+    Q_PROPERTY(int updateBudget READ updateBudget WRITE setUpdateBudget NOTIFY updateBudgetChanged)
+    Q_PROPERTY(QQmlListProperty<TileLayer> layers READ layers)
+    Q_PROPERTY(QVector3D windowMin READ windowMin NOTIFY windowChanged)
+    Q_PROPERTY(QVector3D windowMax READ windowMax NOTIFY windowChanged)
 
 public:
     explicit TileView(QQuick3DNode *parent = nullptr);
@@ -44,9 +95,29 @@ public:
     QVector3D direction() const;
     void setDirection(QVector3D direction);
 
+    float lookAhead() const;
+    void setLookAhead(float lookAhead);
+
+    float rollMargin() const;
+    void setRollMargin(float rollMargin);
+
     QQmlComponent* delegate() const;
     void setDelegate(QQmlComponent *delegate);
 
+    QObject *contentProvider() const;
+    void setContentProvider(QObject *contentProvider);
+
+    int updateBudget() const;
+    void setUpdateBudget(int updateBudget);
+
+    QQmlListProperty<TileLayer> layers();
+
+    QVector3D windowMin() const;
+    QVector3D windowMax() const;
+
+    Q_INVOKABLE QQuick3DNode *layerDelegate(const QString &layerName, const QVector3D &tile) const;
+    Q_INVOKABLE bool dumpTrace(const QString &fileName);
+
     static TileViewAttached *qmlAttachedProperties(QObject *obj);
 
 signals:
@@ -55,6 +126,11 @@ signals:
     void centerChanged();
     void delegateChanged();
     void directionChanged();
+    void lookAheadChanged();
+    void rollMarginChanged();
+    void contentProviderChanged();
+    void updateBudgetChanged();
+    void windowChanged();
 
 public:
     virtual void recreateDelegates();
@@ -64,35 +140,97 @@ protected:
     void componentComplete() override;
 
 private:
+    friend class TileViewAttached;
+
     QVector3D mapTileCoordToPosition(QVector3D tileCoord) const;
     QVector3D mapPositionToTileCoord(QVector3D position) const;
-    QVector3D mapPositionToMatrixCoord(QVector3D position) const;
-    QVector3D mapMatrixCoordToTileCoord(QVector3D matrixCoord) const;
-    QVector3D mapPositionToTileCoordShifted(QVector3D position) const;
+    QVector3D mapPositionToTileCoordShifted(QVector3D position, const QVector3D *currentTileCoord = nullptr) const;
+    float effectiveRollMargin(int axis) const;
+    QVector3D anchorPosition() const;
+    Tile mapCellToTile(const TileGrid<3>::Cell &cell) const;
+    QVector3D mapTileToDelegatePosition(const Tile &tile) const;
 
     void resetAllTiles();
-
-    int matrixCoordShiftedX(int startCoord, int shiftCount) const;
-    int matrixCoordShiftedY(int startCoord, int shiftCount) const;
-    int matrixCoordShiftedZ(int startCoord, int shiftCount) const;
-
+    bool updateWindow();
+    void resetLayer(TileLayer *layer);
     void updateTiles();
+    void updateLayer(TileLayer *layer);
+    bool updateTileBounds(const Tile &tile, int index);
+    void markTileChanged(int index);
+    void markTileDirty(int index);
+    void markAllTilesChanged();
+    void markBoundsPending(int index);
+    void delegateBoundsChanged(const QObject *delegate);
+    bool needsContent(int index) const;
+    void deferContentOverBudget();
+    void scheduleDeferredUpdate();
+    void evictAllContent();
+    void flushContentChanges();
+    TileContentProvider *provider() const;
+    bool contentTileOf(const QQuick3DNode *node, QVector3D *tile) const;
 
+    QQuick3DNode *createDelegate(QQmlComponent *component, const QString &layerName);
     TileViewAttached *getAttachedObject(const QObject *obj) const;
 
+    static void appendLayer(QQmlListProperty<TileLayer> *list, TileLayer *layer);
+    static qsizetype layerCount(QQmlListProperty<TileLayer> *list);
+    static TileLayer *layerAt(QQmlListProperty<TileLayer> *list, qsizetype index);
+    static void clearLayers(QQmlListProperty<TileLayer> *list);
+
 private:
     QVector3D m_tileCount;
     QVector3D m_tileSize;
     QVector3D m_centerPosition;
     QVector3D m_direction;
+    float m_lookAhead = 0;
+    float m_rollMargin = 0;
+
+    // The tile that the window is centered on (see anchorPosition)
+    QVector3D m_anchorTile;
 
-    QPoint m_shiftedTileCoord;
-    QPoint m_prevShiftedTileCoord;
-    Tile m_cornerTile;
+    TileGrid<3> m_grid;
+    TileChunkTree m_chunkTree;
+    QVector<Tile> m_tiles;
+    QVector<bool> m_tileVisible;
 
     QVector<QQuick3DNode *> m_delegateNodes;
+    QHash<const QObject *, int> m_delegateIndices;
+
+    // Cells that got a new tile since the last update, and cells with content
+    // that we don't know the bounds of yet (see updateTiles)
+    std::vector<TileGrid<3>::Cell> m_shiftedCells;
+    QVector<int> m_changedTiles;
+    QVector<bool> m_tileChanged;
+    QVector<int> m_pendingBounds;
+    QVector<bool> m_boundsPending;
+
+    // Cells to look at in the current update: the ones that got a new tile,
+    // changed visibility (m_culledTiles), or were deferred by the last update
+    QVector<int> m_dirtyTiles;
+    QVector<bool> m_tileDirty;
+    QVector<int> m_culledTiles;
+
+    // The tile that each delegate currently shows content for
+    QVector<Tile> m_contentTiles;
+    QVector<bool> m_hasContent;
+
+    // Changes collected during an update, to be handed to the content provider in one go
+    QVector<Tile> m_assignedTiles;
+    QVector<Tile> m_evictedTiles;
+    QVector<Tile> m_visibilityChangedTiles;
+
+    // Tiles that are held back until a later update, because of the update budget
+    QVector<int> m_deferredTiles;
+    QVector<bool> m_tileDeferred;
+    int m_updateBudget = 0;
+    bool m_updatePending = false;
 
     QQmlComponent *m_delegate = nullptr;
+    QPointer<QObject> m_contentProvider;
+
+    // Updated in order after the delegates above, so that a layer can
+    // build on the content that the layers before it show for a tile
+    QVector<TileLayer *> m_layers;
 };
 
 class TileViewAttached : public QObject
@@ -100,6 +238,9 @@ class TileViewAttached : public QObject
     Q_OBJECT
     Q_PROPERTY(TileView *view READ view NOTIFY viewChanged)
     Q_PROPERTY(QVector3D tile READ tile NOTIFY tileChanged)
+    Q_PROPERTY(QString layer READ layer NOTIFY layerChanged)
+    Q_PROPERTY(QVector3D boundsMin READ boundsMin WRITE setBoundsMin NOTIFY boundsMinChanged)
+    Q_PROPERTY(QVector3D boundsMax READ boundsMax WRITE setBoundsMax NOTIFY boundsMaxChanged)
 
 public:
     TileViewAttached(QObject *parent);
@@ -110,13 +251,35 @@ public:
     QVector3D tile() const;
     void setTile(const QVector3D &tile);
 
+    QString layer() const;
+    void setLayer(const QString &layer);
+
+    Q_INVOKABLE QQuick3DNode *layerDelegate(const QString &layerName) const;
+
+    QVector3D boundsMin() const;
+    void setBoundsMin(const QVector3D &boundsMin);
+
+    QVector3D boundsMax() const;
+    void setBoundsMax(const QVector3D &boundsMax);
+
+    bool hasBounds() const;
+    void resetBounds();
+
 signals:
     void viewChanged();
     void tileChanged();
+    void layerChanged();
+    void boundsMinChanged();
+    void boundsMaxChanged();
 
 private:
     QPointer<TileView> m_view = nullptr;
     QVector3D m_tile = QVector3D(std::numeric_limits<float>::infinity(), 0, 0);
+    QString m_layer;
+    QVector3D m_boundsMin;
+    QVector3D m_boundsMax;
+    bool m_hasBoundsMin = false;
+    bool m_hasBoundsMax = false;
 };
 
 #endif // TILEVIEW_H
@@ -0,0 +1,12 @@
+# The adaptive mesh of the terrain example has no dependencies on Qt, and neither has its test
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+TARGET = tst_adaptivemesh
+
+INCLUDEPATH += ../../../examples/terrain
+
+SOURCES += \
+    tst_adaptivemesh.cpp
+
+CONFIG += testcase
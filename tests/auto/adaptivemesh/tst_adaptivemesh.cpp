@@ -0,0 +1,189 @@
+#include "adaptivemesh.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <map>
+#include <numeric>
+#include <random>
+#include <set>
+#include <utility>
+
+// The meshes of a block of neighbouring tiles are built from one height field, and
+// checked for what makes them line up: each tile is covered exactly, no vertex lies
+// in the middle of a triangle edge of the same tile (a T-junction), and neighbours
+// use the same vertices along the edge they share.
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++s_failures; \
+            return; \
+        } \
+    } while (false)
+
+using Point = std::pair<int, int>;
+
+// Smooth hills with rough patches in between, so that the mesh is dense in some places and sparse in others
+struct HeightField
+{
+    uint32_t seed;
+
+    float noise(int x, int z) const
+    {
+        uint32_t h = seed ^ (uint32_t(x) * 73856093u) ^ (uint32_t(z) * 19349663u);
+        h ^= h >> 13;
+        h *= 0x5bd1e995u;
+        h ^= h >> 15;
+        return float(h & 0xffff) / 0xffff - 0.5f;
+    }
+
+    float operator()(int x, int z) const
+    {
+        const float hills = 20 * std::sin(x * 0.05f + seed) * std::cos(z * 0.07f - seed);
+        const float roughness = std::max(0.f, std::sin(x * 0.11f - z * 0.03f + seed) - 0.3f);
+        return hills + roughness * 8 * noise(x, z);
+    }
+};
+
+struct Mesh
+{
+    std::vector<int> corners;
+    std::set<Point> vertices;
+};
+
+// Whether any vertex of the mesh lies on the edge from a to b, other than its ends
+static bool splitsEdge(const Mesh &mesh, const Point &a, const Point &b)
+{
+    const int steps = std::gcd(b.first - a.first, b.second - a.second);
+    const int stepX = (b.first - a.first) / steps;
+    const int stepZ = (b.second - a.second) / steps;
+    for (int i = 1; i < steps; ++i) {
+        if (mesh.vertices.count(Point(a.first + i * stepX, a.second + i * stepZ)))
+            return true;
+    }
+    return false;
+}
+
+static void checkTile(const Mesh &mesh, int n)
+{
+    CHECK(!mesh.corners.empty());
+    CHECK(mesh.corners.size() % 6 == 0);
+
+    long long doubleArea = 0;
+    for (size_t i = 0; i < mesh.corners.size(); i += 6) {
+        const Point a(mesh.corners[i], mesh.corners[i + 1]);
+        const Point b(mesh.corners[i + 2], mesh.corners[i + 3]);
+        const Point c(mesh.corners[i + 4], mesh.corners[i + 5]);
+        const int cross = (b.second - a.second) * (c.first - a.first) - (b.first - a.first) * (c.second - a.second);
+        CHECK(cross > 0); // All triangles face the same way
+        doubleArea += cross;
+
+        for (const Point &p : { a, b, c })
+            CHECK(p.first >= 0 && p.first <= n && p.second >= 0 && p.second <= n);
+
+        // A vertex in the middle of an edge means the triangle doesn't share that edge
+        // with the triangle on the other side, which leaves a crack in the terrain
+        CHECK(!splitsEdge(mesh, a, b));
+        CHECK(!splitsEdge(mesh, b, c));
+        CHECK(!splitsEdge(mesh, c, a));
+    }
+    CHECK(doubleArea == 2LL * n * n);
+}
+
+static std::vector<int> edgeVertices(const Mesh &mesh, bool alongX, int fixed)
+{
+    std::vector<int> result;
+    for (const Point &p : mesh.vertices) {
+        if (alongX && p.second == fixed)
+            result.push_back(p.first);
+        else if (!alongX && p.first == fixed)
+            result.push_back(p.second);
+    }
+    return result;
+}
+
+static void checkBlock(const HeightField &field, int n, float maxError, int maxEdgeSegment)
+{
+    const int tiles = 4;
+    std::map<Point, Mesh> meshes;
+    for (int tz = 0; tz < tiles; ++tz) {
+        for (int tx = 0; tx < tiles; ++tx) {
+            AdaptiveMesh builder(n, maxError, maxEdgeSegment);
+            const int band = builder.bandWidth();
+            Mesh &mesh = meshes[Point(tx, tz)];
+            mesh.corners = builder.build([&](int x, int z) {
+                // Only the bands along the edges are asked for, not the corners beyond them
+                const bool insideX = x >= 0 && x <= n;
+                const bool insideZ = z >= 0 && z <= n;
+                if (!(insideX && insideZ) && !(insideX && z >= -band && z <= n + band)
+                        && !(insideZ && x >= -band && x <= n + band)) {
+                    ++s_failures;
+                }
+                return field(tx * n + x, tz * n + z);
+            });
+            for (size_t i = 0; i < mesh.corners.size(); i += 2)
+                mesh.vertices.insert(Point(mesh.corners[i], mesh.corners[i + 1]));
+            checkTile(mesh, n);
+        }
+    }
+
+    for (int tz = 0; tz < tiles; ++tz) {
+        for (int tx = 0; tx < tiles; ++tx) {
+            const Mesh &mesh = meshes[Point(tx, tz)];
+            if (tx + 1 < tiles)
+                CHECK(edgeVertices(mesh, false, n) == edgeVertices(meshes[Point(tx + 1, tz)], false, 0));
+            if (tz + 1 < tiles)
+                CHECK(edgeVertices(mesh, true, n) == edgeVertices(meshes[Point(tx, tz + 1)], true, 0));
+        }
+    }
+}
+
+static void testFlatTile()
+{
+    // Only the vertices that the edges always need
+    AdaptiveMesh builder(32, 0.5f, 8);
+    const std::vector<int> corners = builder.build([](int, int) { return 1.f; });
+    Mesh mesh;
+    mesh.corners = corners;
+    for (size_t i = 0; i < corners.size(); i += 2)
+        mesh.vertices.insert(Point(corners[i], corners[i + 1]));
+    checkTile(mesh, 32);
+    CHECK(edgeVertices(mesh, true, 0) == std::vector<int>({ 0, 1, 2, 4, 8, 16, 24, 28, 30, 31, 32 }));
+    CHECK(corners.size() / 6 < 2048 / 4);
+}
+
+static void testFullDetail()
+{
+    // With a rough enough height field every grid point is used
+    const HeightField field = { 7 };
+    AdaptiveMesh builder(16, 0, 8);
+    const std::vector<int> corners = builder.build([&](int x, int z) { return field.noise(x, z); });
+    CHECK(corners.size() / 6 == 2 * 16 * 16);
+}
+
+int main()
+{
+    testFlatTile();
+    testFullDetail();
+
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> errorDistribution(0.05f, 4.f);
+    for (int round = 0; round < 40 && s_failures == 0; ++round) {
+        const HeightField field = { uint32_t(random()) };
+        for (int n : { 2, 4, 8, 16, 32 })
+            checkBlock(field, n, errorDistribution(random), 8);
+        checkBlock(field, 32, errorDistribution(random), 4);
+    }
+
+    if (s_failures) {
+        std::fprintf(stderr, "FAIL: %d check(s) failed\n", s_failures);
+        return 1;
+    }
+    std::printf("PASS\n");
+    return 0;
+}
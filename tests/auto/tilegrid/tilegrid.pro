@@ -0,0 +1,12 @@
+# TileGrid has no dependencies on Qt, and neither has its test
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+TARGET = tst_tilegrid
+
+INCLUDEPATH += ../../../src
+
+SOURCES += \
+    tst_tilegrid.cpp
+
+CONFIG += testcase
@@ -0,0 +1,204 @@
+#include "tilegrid.h"
+
+#include <cstdio>
+#include <random>
+#include <set>
+
+// TileGrid is checked against a brute force model of the window. A cell never moves in
+// the ring buffer, so along each axis it keeps mapping to the tiles that are congruent
+// to it (modulo the count) with the same offset as right after the reset. The model
+// just searches the window for that tile.
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            ++s_failures; \
+            return; \
+        } \
+    } while (false)
+
+template <int Dims>
+struct Model
+{
+    using Coord = typename TileGrid<Dims>::Coord;
+
+    Coord count;
+    Coord origin;
+    Coord resetOrigin;
+
+    void reset(const Coord &c, const Coord &o)
+    {
+        count = c;
+        origin = o;
+        resetOrigin = o;
+    }
+
+    Coord tileCoordOf(const Coord &matrixCoord) const
+    {
+        Coord tile = {};
+        for (int axis = 0; axis < Dims; ++axis) {
+            for (int32_t t = origin[axis]; t < origin[axis] + count[axis]; ++t) {
+                const int32_t offset = t - matrixCoord[axis] - resetOrigin[axis];
+                if (((offset % count[axis]) + count[axis]) % count[axis] == 0)
+                    tile[axis] = t;
+            }
+        }
+        return tile;
+    }
+};
+
+template <int Dims>
+static void checkCells(const TileGrid<Dims> &grid, const Model<Dims> &model)
+{
+    CHECK(grid.originTile() == model.origin);
+
+    int32_t expectedIndex = 0;
+    bool cellsOk = true;
+    grid.forEachCell([&](const typename TileGrid<Dims>::Cell &cell) {
+        cellsOk &= cell.index == expectedIndex++;
+        cellsOk &= cell.index == grid.indexOf(cell.matrixCoord);
+        cellsOk &= cell.tileCoord == model.tileCoordOf(cell.matrixCoord);
+        cellsOk &= grid.tileCoordOf(cell.matrixCoord) == cell.tileCoord;
+        cellsOk &= grid.matrixCoordOf(cell.tileCoord) == cell.matrixCoord;
+        cellsOk &= grid.contains(cell.tileCoord);
+    });
+    CHECK(cellsOk);
+    CHECK(expectedIndex == grid.cellCount());
+
+    // Tiles just outside the window along each axis
+    for (int axis = 0; axis < Dims; ++axis) {
+        typename TileGrid<Dims>::Coord outside = model.origin;
+        outside[axis] = model.origin[axis] - 1;
+        CHECK(!grid.contains(outside));
+        outside[axis] = model.origin[axis] + model.count[axis];
+        CHECK(!grid.contains(outside));
+    }
+}
+
+template <int Dims>
+static void checkChanged(const TileGrid<Dims> &grid, const Model<Dims> &before, const Model<Dims> &after,
+                         const std::vector<typename TileGrid<Dims>::Cell> &changed)
+{
+    std::set<int32_t> reported;
+    for (const auto &cell : changed) {
+        CHECK(reported.insert(cell.index).second); // Each cell is only reported once
+        CHECK(cell.tileCoord == after.tileCoordOf(cell.matrixCoord));
+    }
+
+    std::set<int32_t> expected;
+    grid.forEachCell([&](const typename TileGrid<Dims>::Cell &cell) {
+        if (before.tileCoordOf(cell.matrixCoord) != after.tileCoordOf(cell.matrixCoord))
+            expected.insert(cell.index);
+    });
+    CHECK(reported == expected);
+}
+
+template <int Dims>
+static void fuzz(std::mt19937 &random, int rounds)
+{
+    using Coord = typename TileGrid<Dims>::Coord;
+    std::uniform_int_distribution<int32_t> countDistribution(1, 6);
+    std::uniform_int_distribution<int32_t> originDistribution(-20, 20);
+    std::uniform_int_distribution<int32_t> deltaDistribution(-8, 8);
+    std::uniform_int_distribution<int32_t> actionDistribution(0, 9);
+
+    for (int round = 0; round < rounds && s_failures == 0; ++round) {
+        Coord count;
+        Coord origin;
+        for (int axis = 0; axis < Dims; ++axis) {
+            count[axis] = countDistribution(random);
+            origin[axis] = originDistribution(random);
+        }
+
+        TileGrid<Dims> grid;
+        Model<Dims> model;
+        grid.reset(count, origin);
+        model.reset(count, origin);
+        checkCells(grid, model);
+
+        for (int step = 0; step < 50 && s_failures == 0; ++step) {
+            const Model<Dims> before = model;
+            const int action = actionDistribution(random);
+            Coord delta;
+            for (int axis = 0; axis < Dims; ++axis)
+                delta[axis] = action == 0 ? 0 : deltaDistribution(random);
+            for (int axis = 0; axis < Dims; ++axis)
+                model.origin[axis] += delta[axis];
+
+            std::vector<typename TileGrid<Dims>::Cell> changed;
+            if (action == 1) {
+                grid.shift(delta);
+            } else if (action < 5) {
+                grid.moveTo(model.origin, &changed);
+                checkChanged(grid, before, model, changed);
+            } else {
+                grid.shift(delta, &changed);
+                checkChanged(grid, before, model, changed);
+            }
+            checkCells(grid, model);
+        }
+    }
+}
+
+static void testWrapped()
+{
+    CHECK(TileGrid<1>::wrapped(0, 0, 4) == 0);
+    CHECK(TileGrid<1>::wrapped(3, 1, 4) == 0);
+    CHECK(TileGrid<1>::wrapped(0, -1, 4) == 3);
+    CHECK(TileGrid<1>::wrapped(1, -9, 4) == 0);
+    CHECK(TileGrid<1>::wrapped(2, 11, 4) == 1);
+}
+
+static void testReset()
+{
+    TileGrid<2> grid;
+    CHECK(grid.cellCount() == 0);
+    CHECK(!grid.contains({ 0, 0 }));
+
+    grid.reset({ 3, 2 }, { -1, 5 });
+    CHECK(grid.cellCount() == 6);
+    CHECK((grid.originTile() == TileGrid<2>::Coord{ -1, 5 }));
+    CHECK((grid.cornerTile() == TileGrid<2>::Coord{ 1, 6 }));
+    CHECK((grid.tileCoordOf({ 0, 0 }) == TileGrid<2>::Coord{ -1, 5 }));
+    CHECK((grid.tileCoordOf({ 2, 1 }) == TileGrid<2>::Coord{ 1, 6 }));
+}
+
+static void testShiftReportsEnteringRow()
+{
+    TileGrid<2> grid;
+    grid.reset({ 4, 4 });
+
+    std::vector<TileGrid<2>::Cell> changed;
+    grid.shift({ 1, 0 }, &changed);
+    CHECK(changed.size() == 4);
+    for (const auto &cell : changed) {
+        CHECK(cell.matrixCoord[0] == 0); // The row that fell out at the low end is reused
+        CHECK(cell.tileCoord[0] == 4);
+    }
+
+    // Moving further than the window is wide changes every cell, but only once
+    grid.shift({ -10, 7 }, &changed);
+    CHECK(changed.size() == 16);
+}
+
+int main()
+{
+    testWrapped();
+    testReset();
+    testShiftReportsEnteringRow();
+
+    std::mt19937 random(1234);
+    fuzz<1>(random, 200);
+    fuzz<2>(random, 200);
+    fuzz<3>(random, 200);
+
+    if (s_failures) {
+        std::fprintf(stderr, "FAIL: %d check(s) failed\n", s_failures);
+        return 1;
+    }
+    std::printf("PASS\n");
+    return 0;
+}
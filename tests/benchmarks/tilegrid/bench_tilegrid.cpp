@@ -0,0 +1,66 @@
+#include "tilegrid.h"
+
+#include <chrono>
+#include <cstdio>
+
+// Measures the bookkeeping that TileView does when the window rolls, without
+// any Qt Quick on top: shifting the grid, collecting the cells that changed,
+// and mapping every cell to its tile.
+
+template <typename Func>
+static void run(const char *name, int iterations, Func func)
+{
+    // Warm up, so that the vectors have their capacity before we measure
+    for (int i = 0; i < iterations / 10 + 1; ++i)
+        func(i);
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i)
+        func(i);
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    const double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+    std::printf("%-40s %12.1f ns\n", name, nanoseconds);
+}
+
+int main()
+{
+    std::vector<TileGrid<3>::Cell> changed;
+    int64_t sink = 0;
+
+    TileGrid<2> grid2;
+    grid2.reset({ 64, 64 });
+    run("2D 64x64 shift by one", 100000, [&](int i) {
+        grid2.shift({ (i & 1) ? 1 : 0, (i & 1) ? 0 : 1 });
+    });
+
+    std::vector<TileGrid<2>::Cell> changed2;
+    run("2D 64x64 shift by one, changed cells", 100000, [&](int i) {
+        grid2.shift({ (i & 1) ? 1 : 0, (i & 1) ? 0 : 1 }, &changed2);
+        sink += changed2.size();
+    });
+
+    run("2D 64x64 moveTo far away, changed cells", 10000, [&](int i) {
+        grid2.moveTo({ i * 100, -i * 100 }, &changed2);
+        sink += changed2.size();
+    });
+
+    TileGrid<3> grid3;
+    grid3.reset({ 16, 16, 16 });
+    run("3D 16^3 shift by one, changed cells", 100000, [&](int i) {
+        grid3.shift({ 1, (i & 1) ? 1 : -1, 0 }, &changed);
+        sink += changed.size();
+    });
+
+    run("3D 16^3 forEachCell", 10000, [&](int) {
+        grid3.forEachCell([&](const TileGrid<3>::Cell &cell) { sink += cell.tileCoord[0]; });
+    });
+
+    run("3D 16^3 tileCoordOf + matrixCoordOf", 1000000, [&](int i) {
+        const TileGrid<3>::Coord m = { i & 15, (i >> 4) & 15, (i >> 8) & 15 };
+        sink += grid3.matrixCoordOf(grid3.tileCoordOf(m))[0];
+    });
+
+    // Keep the compiler from optimizing the work away
+    std::printf("(%lld)\n", static_cast<long long>(sink));
+    return 0;
+}
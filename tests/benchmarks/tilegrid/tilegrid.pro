@@ -0,0 +1,9 @@
+TEMPLATE = app
+CONFIG += console c++17
+CONFIG -= qt app_bundle
+TARGET = bench_tilegrid
+
+INCLUDEPATH += ../../../src
+
+SOURCES += \
+    bench_tilegrid.cpp